@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "arena.h"
+
+// Chunks grow geometrically up to this size, larger allocations get a chunk of their own
+static constexpr std::size_t max_chunk_size = 16 * 1024 * 1024;
+
+/**
+ * Arena class constructor
+ * No memory is reserved until the first allocation
+ * @param chunk_size the size of the first chunk
+ */
+Arena::Arena(std::size_t chunk_size) : initial_chunk_size(chunk_size), next_chunk_size(chunk_size) {}
+
+Arena::~Arena() {
+    release();
+}
+
+/**
+ * Copies a string into the arena
+ * @param string the string to copy
+ * @return a view of the copy, valid until the arena is released
+ */
+std::string_view Arena::copy(std::string_view string) {
+    auto data = static_cast<char *>(allocate(string.size() == 0 ? 1 : string.size(), 1));
+    std::memcpy(data, string.data(), string.size());
+    return {data, string.size()};
+}
+
+/**
+ * Frees every chunk at once, invalidating everything that was allocated from the arena
+ * The cost depends only on the number of chunks, which grows logarithmically with the bytes allocated
+ */
+void Arena::release() {
+    while (chunks != nullptr) {
+        auto next = chunks->next;
+        ::operator delete(chunks);
+        chunks = next;
+    }
+    cursor = limit = nullptr;
+    next_chunk_size = initial_chunk_size;
+}
+
+/**
+ * Bumps the cursor of the current chunk, starting a new chunk when the allocation does not fit
+ * @param bytes the size of the allocation
+ * @param alignment the alignment of the allocation, a power of two
+ * @return the allocated memory
+ */
+void *Arena::do_allocate(std::size_t bytes, std::size_t alignment) {
+    auto aligned = reinterpret_cast<std::byte *>((reinterpret_cast<std::uintptr_t>(cursor) + alignment - 1) & ~(alignment - 1));
+    if (cursor == nullptr || aligned + bytes > limit) {
+        auto size = std::max(next_chunk_size, sizeof(Chunk) + bytes + alignment);
+        auto chunk = static_cast<Chunk *>(::operator new(size));
+        chunk->next = chunks;
+        chunk->size = size;
+        chunks = chunk;
+        next_chunk_size = std::min(next_chunk_size * 2, max_chunk_size);
+
+        cursor = reinterpret_cast<std::byte *>(chunk + 1);
+        limit = reinterpret_cast<std::byte *>(chunk) + size;
+        aligned = reinterpret_cast<std::byte *>((reinterpret_cast<std::uintptr_t>(cursor) + alignment - 1) & ~(alignment - 1));
+    }
+    cursor = aligned + bytes;
+    return aligned;
+}
+
+/**
+ * Individual allocations are never freed, their memory is reclaimed when the arena is released
+ */
+void Arena::do_deallocate(void *, std::size_t, std::size_t) {}
+
+bool Arena::do_is_equal(const std::pmr::memory_resource &other) const noexcept {
+    return this == &other;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+/**
+ * A monotonic bump allocator that owns everything allocated during one compilation
+ * Nothing is freed on its own, the whole arena is released at once when the compilation ends
+ * Containers allocate from it through the `std::pmr` allocator interface
+ */
+class Arena : public std::pmr::memory_resource {
+public:
+    explicit Arena(std::size_t chunk_size = 64 * 1024);
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+    ~Arena() override;
+
+    template<typename T, typename... Args>
+    T *create(Args &&... args);
+    std::string_view copy(std::string_view string);
+    void release();
+
+private:
+    struct Chunk {
+        Chunk *next;
+        std::size_t size;
+    };
+
+    Chunk *chunks = nullptr;
+    std::byte *cursor = nullptr;
+    std::byte *limit = nullptr;
+    std::size_t initial_chunk_size;
+    std::size_t next_chunk_size;
+
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void *pointer, std::size_t bytes, std::size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+};
+
+/**
+ * Constructs an object in the arena
+ * Destructors are never run, so only trivially destructible objects may live in the arena
+ * @param args the constructor arguments
+ * @return the new object, valid until the arena is released
+ */
+template<typename T, typename... Args>
+T *Arena::create(Args &&... args) {
+    static_assert(std::is_trivially_destructible_v<T>, "arena objects are never destroyed");
+    return new(allocate(sizeof(T), alignof(T))) T{std::forward<Args>(args)...};
+}
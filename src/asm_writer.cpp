@@ -0,0 +1,51 @@
+#include "asm_writer.h"
+
+/**
+ * AsmWriter class constructor
+ * @param out the stream that the assembly is written to
+ */
+AsmWriter::AsmWriter(std::ostream &out) : out(out) {
+    buffer.reserve(block_size + 4096);
+}
+
+AsmWriter::~AsmWriter() {
+    flush();
+}
+
+/**
+ * Writes out everything buffered so far, with a single write to the stream
+ */
+void AsmWriter::flush() {
+    if (buffer.empty())
+        return;
+    out.write(buffer.data(), buffer.size());
+    out.flush();
+    buffer.clear();
+}
+
+void AsmWriter::append(const Name &name) {
+    switch (name.kind) {
+        case NameKind::None:
+            break;
+        case NameKind::Label:
+            buffer.push_back('L');
+            append(name.number);
+            break;
+        case NameKind::Global:
+            buffer.push_back('G');
+            append(name.number);
+            break;
+        case NameKind::String:
+            buffer.push_back('S');
+            append(name.number);
+            break;
+        case NameKind::Function:
+        case NameKind::Literal:
+            buffer.append(name.text);
+            break;
+        case NameKind::Epilogue:
+            buffer.append(name.text);
+            buffer.append("_epilogue");
+            break;
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <charconv>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "mir.h"
+
+/**
+ * Buffers assembly output, so lines are formatted straight into one buffer rather than through temporary strings
+ * The buffer is written out in large blocks, and once more when it is flushed
+ */
+class AsmWriter {
+public:
+    explicit AsmWriter(std::ostream &out);
+    AsmWriter(const AsmWriter &) = delete;
+    AsmWriter &operator=(const AsmWriter &) = delete;
+    ~AsmWriter();
+
+    template<typename... Pieces>
+    void line(const Pieces &... pieces);
+    void flush();
+
+private:
+    // The buffer is written out whenever it grows past this size
+    static constexpr std::size_t block_size = 1 << 20;
+
+    std::ostream &out;
+    std::string buffer;
+
+    void append(std::string_view piece) { buffer.append(piece); }
+    void append(const char *piece) { buffer.append(piece); }
+    void append(const std::string &piece) { buffer.append(piece); }
+    void append(char piece) { buffer.push_back(piece); }
+    void append(Reg reg) { buffer.append(name(reg)); }
+    void append(const Name &name);
+
+    template<typename Integer, typename = std::enable_if_t<std::is_integral_v<Integer>>>
+    void append(Integer value);
+};
+
+/**
+ * Appends one line of assembly
+ * @param pieces the pieces of the line, each a string, a character, an integer, a register or a name
+ */
+template<typename... Pieces>
+void AsmWriter::line(const Pieces &... pieces) {
+    (append(pieces), ...);
+    buffer.push_back('\n');
+    if (buffer.size() >= block_size)
+        flush();
+}
+
+template<typename Integer, typename>
+void AsmWriter::append(Integer value) {
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    buffer.append(digits, result.ptr);
+}
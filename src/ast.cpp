@@ -2,67 +2,168 @@
 #include<iostream>
 #include <sstream>
 
-AST::AST(std::string type, std::string attr, int line, int column) : type(type), attr(attr), line(line),
-                                                                     column(column), sym(nullptr) {}
-
-AST::AST(std::string type) : AST(type, "", -1, -1) {}
-
-AST::AST(std::string type, std::string attr) : AST(type, attr, -1, -1) {}
-
-AST::AST(std::string type, int line, int column) : AST(type, "", line, column) {}
-
-AST *AST::add_child(AST *child) {
-    children.push_back(child);
-    return this;
+/**
+ * Gets the textual name of a node kind, as printed in the tree dump
+ * @param kind the node kind
+ * @return the name of the node kind
+ */
+std::string_view name(NodeKind kind) {
+    switch (kind) {
+        case NodeKind::Program: return "program";
+        case NodeKind::GlobalVar: return "globalvar";
+        case NodeKind::Var: return "var";
+        case NodeKind::Func: return "func";
+        case NodeKind::Sig: return "sig";
+        case NodeKind::Formals: return "formals";
+        case NodeKind::Formal: return "formal";
+        case NodeKind::NewId: return "newid";
+        case NodeKind::TypeId: return "typeid";
+        case NodeKind::Block: return "block";
+        case NodeKind::If: return "if";
+        case NodeKind::Else: return "else";
+        case NodeKind::For: return "for";
+        case NodeKind::Break: return "break";
+        case NodeKind::Return: return "return";
+        case NodeKind::EmptyStmt: return "emptystmt";
+        case NodeKind::FuncCall: return "funccall";
+        case NodeKind::Actuals: return "actuals";
+        case NodeKind::Id: return "id";
+        case NodeKind::Int: return "int";
+        case NodeKind::String: return "string";
+        case NodeKind::Assign: return "=";
+        case NodeKind::Or: return "||";
+        case NodeKind::And: return "&&";
+        case NodeKind::Equal: return "==";
+        case NodeKind::NotEqual: return "!=";
+        case NodeKind::Less: return "<";
+        case NodeKind::LessEqual: return "<=";
+        case NodeKind::Greater: return ">";
+        case NodeKind::GreaterEqual: return ">=";
+        case NodeKind::Add: return "+";
+        case NodeKind::Subtract: return "-";
+        case NodeKind::Multiply: return "*";
+        case NodeKind::Divide: return "/";
+        case NodeKind::Modulo: return "%";
+        case NodeKind::Not: return "!";
+        case NodeKind::Negate: return "u-";
+    }
+    return "";
 }
 
-AST *AST::get_child(int index) {
-    return children.at(index);
+/**
+ * Tree class constructor
+ * @param arena the arena of the compilation, which must outlive the tree
+ */
+Tree::Tree(Arena &arena)
+        : arena(arena), nodes(&arena), child_ids(&arena), sigs(&arena), regs(&arena), syms(&arena), strings(&arena) {}
+
+/**
+ * Appends a node whose children have already been added
+ * @param kind the kind of the node
+ * @param attr the attribute of the node, which must outlive the tree
+ * @param symbol the interned id of an identifier node, or `no_symbol`
+ * @param line the line of the node, or -1 if it has no location
+ * @param column the column of the node, or -1 if it has no location
+ * @param first the first child handle
+ * @param last one past the last child handle
+ * @return a handle to the new node
+ */
+template<typename Iterator>
+AST Tree::add(NodeKind kind, std::string_view attr, SymbolId symbol, int line, int column, Iterator first, Iterator last) {
+    NodeId id = nodes.size();
+    std::uint32_t first_child = child_ids.size();
+    for (auto child = first; child != last; ++child)
+        child_ids.push_back(child->id);
+    nodes.push_back({kind, symbol, attr, line, column, first_child, static_cast<std::uint32_t>(child_ids.size() - first_child)});
+    sigs.push_back(nullptr);
+    regs.push_back(Reg::None);
+    syms.push_back(nullptr);
+    return {this, id};
 }
 
-void AST::print() {
-    print(0);
+AST Tree::add(NodeKind kind, std::string_view attr, SymbolId symbol, int line, int column) {
+    std::initializer_list<AST> children = {};
+    return add(kind, attr, symbol, line, column, children.begin(), children.end());
 }
 
-void AST::print(int indent) {
-    // Indentation
-    std::stringstream ss;
-    ss << std::string(indent, '\t');
-    ss << type;
-
-    // AST has an attribute
-    if (attr.length() > 0)
-        ss << " [" << attr << "]";
+AST Tree::add(NodeKind kind, std::string_view attr, int line, int column, const std::vector<AST> &children) {
+    return add(kind, attr, no_symbol, line, column, children.begin(), children.end());
+}
 
-    // AST has a sig(nature type)
-    if (sig.length() > 0)
-        ss << " sig=" << sig;
+AST Tree::add(NodeKind kind, std::string_view attr, int line, int column, std::initializer_list<AST> children) {
+    return add(kind, attr, no_symbol, line, column, children.begin(), children.end());
+}
 
-    // AST has a sym(bol table reference)
-    if (sym != NULL)
-        ss << " sym=" << sym;
+AST Tree::add(NodeKind kind, int line, int column, std::initializer_list<AST> children) {
+    return add(kind, "", line, column, children);
+}
 
-    // AST has location data
-    if (line >= 0)
-        ss << " @ (" << line << ", " << column << ")";
+AST Tree::add(NodeKind kind, std::initializer_list<AST> children) {
+    return add(kind, "", -1, -1, children);
+}
 
-    // Print string and print children
-    std::cout << ss.str() << std::endl;
-    for (auto child: children)
-        child->print(indent + 1);
+/**
+ * Turns a node into a leaf in place, keeping its location and annotations
+ * Its children are left in the tree, but are no longer reachable
+ * @param node the node to replace
+ * @param kind the new kind of the node
+ * @param attr the new attribute of the node, which must outlive the tree
+ * @param symbol the interned id of an identifier node, or `no_symbol`
+ */
+void Tree::replace(AST node, NodeKind kind, std::string_view attr, SymbolId symbol) {
+    auto &replaced = nodes[node.id];
+    replaced = {kind, symbol, attr, replaced.line, replaced.column, 0, 0};
 }
 
-void AST::pre(std::function<void(AST *ast)> callback) {
-    pre_post(callback, [](auto) {});
+/**
+ * Turns a node into a copy of another node, which shares its children and annotations
+ * @param node the node to replace
+ * @param with the node to copy
+ */
+void Tree::replace(AST node, AST with) {
+    nodes[node.id] = nodes[with.id];
+    sigs[node.id] = sigs[with.id];
+    regs[node.id] = regs[with.id];
+    syms[node.id] = syms[with.id];
 }
 
-void AST::post(std::function<void(AST *ast)> callback) {
-    pre_post([](auto) {}, callback);
+/**
+ * Interns a string that does not appear in the source, such as a synthesized name
+ * @param string the string to intern
+ * @return a view of the interned string, valid for the lifetime of the arena
+ */
+std::string_view Tree::intern(const std::string &string) {
+    auto iter = strings.find(string);
+    if (iter != strings.end())
+        return *iter;
+    return *strings.insert(arena.copy(string)).first;
 }
 
-void AST::pre_post(std::function<void(AST *ast)> pre_callback, std::function<void(AST *ast)> post_callback) {
-    pre_callback(this);
-    for (auto child: children)
-        child->pre_post(pre_callback, post_callback);
-    post_callback(this);
-}
\ No newline at end of file
+void AST::print() const {
+    int indent = 0;
+    pre_post([&indent](AST ast) {
+                 // Indentation
+                 std::stringstream ss;
+                 ss << std::string(indent++, '\t');
+                 ss << name(ast.kind());
+
+                 // AST has an attribute
+                 if (ast.attr().length() > 0)
+                     ss << " [" << ast.attr() << "]";
+
+                 // AST has a sig(nature type)
+                 if (ast.sig() != nullptr)
+                     ss << " sig=" << ast.sig()->name;
+
+                 // AST has a sym(bol table reference)
+                 if (ast.sym() != NULL)
+                     ss << " sym=" << ast.sym();
+
+                 // AST has location data
+                 if (ast.line() >= 0)
+                     ss << " @ (" << ast.line() << ", " << ast.column() << ")";
+
+                 std::cout << ss.str() << std::endl;
+             },
+             [&indent](AST) { indent--; });
+}
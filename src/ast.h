@@ -1,32 +1,274 @@
 #pragma once
 
+#include <cstdint>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <memory_resource>
+#include <unordered_set>
 #include <vector>
-#include <functional>
+#include <initializer_list>
+#include "arena.h"
+#include "interner.h"
+#include "mir.h"
 #include "record.h"
 
+using NodeId = std::uint32_t;
+
+/**
+ * The kind of an AST node, assigned by the parser
+ * Scoped, since many of the names are shared with the token types
+ */
+enum class NodeKind : std::uint8_t {
+    Program,
+    GlobalVar,
+    Var,
+    Func,
+    Sig,
+    Formals,
+    Formal,
+    NewId,
+    TypeId,
+    Block,
+    If,
+    Else,
+    For,
+    Break,
+    Return,
+    EmptyStmt,
+    FuncCall,
+    Actuals,
+    Id,
+    Int,
+    String,
+    Assign,
+    Or,
+    And,
+    Equal,
+    NotEqual,
+    Less,
+    LessEqual,
+    Greater,
+    GreaterEqual,
+    Add,
+    Subtract,
+    Multiply,
+    Divide,
+    Modulo,
+    Not,
+    Negate,
+};
+
+inline constexpr std::size_t node_kinds = static_cast<std::size_t>(NodeKind::Negate) + 1;
+
+std::string_view name(NodeKind kind);
+
+class Tree;
+
+/**
+ * A handle to a single node of a `Tree`
+ * Handles are as cheap to copy as a pointer, and are passed around by value
+ */
 class AST {
 public:
-    std::string attr;
-    std::string type;
-	std::string sig;
-	std::string reg;
-	Record* sym;
-    int line;
-    int column;
-    std::vector<AST*> children;
-
-    AST(std::string type);
-    AST(std::string type, std::string attr);
-    AST(std::string type, std::string attr, int line, int column);
-    AST(std::string type, int line, int column);
-    AST* add_child(AST* child);
-    AST* get_child(int index);
-    void print();
-    void pre(std::function<void(AST *ast)> callback);
-    void post(std::function<void(AST *ast)> callback);
-    void pre_post(std::function<void(AST *ast)> pre_callback, std::function<void(AST *ast)> post_callback);
+    class Children;
+
+    AST();
+    AST(Tree *tree, NodeId id);
+    NodeKind kind() const;
+    std::string_view attr() const;
+    SymbolId symbol() const;
+    int line() const;
+    int column() const;
+    const Type *&sig() const;
+    Reg &reg() const;
+    Record *&sym() const;
+    AST get_child(int index) const;
+    Children children() const;
+    void print() const;
+    template<typename Callback>
+    void pre(Callback &&callback) const;
+    template<typename Callback>
+    void post(Callback &&callback) const;
+    template<typename PreCallback, typename PostCallback>
+    void pre_post(PreCallback &&pre_callback, PostCallback &&post_callback) const;
+
+    Tree *tree;
+    NodeId id;
+};
+
+/**
+ * The children of a node, iterable as handles
+ */
+class AST::Children {
+public:
+    class Iterator {
+    public:
+        Iterator(Tree *tree, const NodeId *id) : tree(tree), id(id) {}
+        AST operator*() const { return {tree, *id}; }
+        Iterator &operator++() { id++; return *this; }
+        bool operator!=(const Iterator &other) const { return id != other.id; }
+
+    private:
+        Tree *tree;
+        const NodeId *id;
+    };
+
+    Children(Tree *tree, const NodeId *first, std::uint32_t count) : tree(tree), first(first), count(count) {}
+    Iterator begin() const { return {tree, first}; }
+    Iterator end() const { return {tree, first + count}; }
+    std::uint32_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+private:
+    Tree *tree;
+    const NodeId *first;
+    std::uint32_t count;
+};
+
+/**
+ * Flat storage for an abstract syntax tree
+ * Nodes live in one contiguous vector and are addressed by 32-bit ids
+ * The children of a node are a contiguous range of ids in a side array, so a node is added after its children
+ * Strings are views into the source, or into the tree's pool of interned strings
+ * Semantic annotations are kept in arrays parallel to the nodes
+ * Everything the tree holds is allocated from the arena of its compilation
+ */
+class Tree {
+public:
+    struct Node {
+        NodeKind kind;
+        SymbolId symbol;
+        std::string_view attr;
+        int line;
+        int column;
+        std::uint32_t first_child;
+        std::uint32_t child_count;
+    };
+
+    explicit Tree(Arena &arena);
+
+    Arena &arena;
+    std::pmr::vector<Node> nodes;
+    std::pmr::vector<NodeId> child_ids;
+
+    // Semantic annotations, indexed by node id
+    std::pmr::vector<const Type *> sigs;
+    std::pmr::vector<Reg> regs;
+    std::pmr::vector<Record *> syms;
+
+    AST add(NodeKind kind, std::string_view attr, SymbolId symbol, int line, int column);
+    AST add(NodeKind kind, std::string_view attr, int line, int column, const std::vector<AST> &children);
+    AST add(NodeKind kind, std::string_view attr, int line, int column, std::initializer_list<AST> children = {});
+    AST add(NodeKind kind, int line, int column, std::initializer_list<AST> children = {});
+    AST add(NodeKind kind, std::initializer_list<AST> children = {});
+    void replace(AST node, NodeKind kind, std::string_view attr, SymbolId symbol = no_symbol);
+    void replace(AST node, AST with);
+    std::string_view intern(const std::string &string);
 
 private:
-    void print(int indent);
+    std::pmr::unordered_set<std::string_view> strings;
+
+    template<typename Iterator>
+    AST add(NodeKind kind, std::string_view attr, SymbolId symbol, int line, int column, Iterator first, Iterator last);
 };
+
+inline AST::AST() : tree(nullptr), id(0) {}
+
+inline AST::AST(Tree *tree, NodeId id) : tree(tree), id(id) {}
+
+inline NodeKind AST::kind() const { return tree->nodes[id].kind; }
+
+inline std::string_view AST::attr() const { return tree->nodes[id].attr; }
+
+inline SymbolId AST::symbol() const { return tree->nodes[id].symbol; }
+
+inline int AST::line() const { return tree->nodes[id].line; }
+
+inline int AST::column() const { return tree->nodes[id].column; }
+
+inline const Type *&AST::sig() const { return tree->sigs[id]; }
+
+inline Reg &AST::reg() const { return tree->regs[id]; }
+
+inline Record *&AST::sym() const { return tree->syms[id]; }
+
+inline AST AST::get_child(int index) const {
+    auto &node = tree->nodes[id];
+    if (index < 0 || index >= node.child_count)
+        throw std::out_of_range("AST::get_child");
+    return {tree, tree->child_ids[node.first_child + index]};
+}
+
+inline AST::Children AST::children() const {
+    auto &node = tree->nodes[id];
+    return {tree, tree->child_ids.data() + node.first_child, node.child_count};
+}
+
+/**
+ * Visits every node of the subtree in pre-order
+ * @param callback called with each node before its children
+ */
+template<typename Callback>
+void AST::pre(Callback &&callback) const {
+    pre_post(callback, [](AST) {});
+}
+
+/**
+ * Visits every node of the subtree in post-order
+ * @param callback called with each node after its children
+ */
+template<typename Callback>
+void AST::post(Callback &&callback) const {
+    pre_post([](AST) {}, callback);
+}
+
+/**
+ * Visits every node of the subtree, both before and after its children
+ * The walk keeps an explicit stack rather than recursing, so the depth of the tree is not limited by the call stack
+ * @param pre_callback called with each node before its children
+ * @param post_callback called with each node after its children
+ */
+template<typename PreCallback, typename PostCallback>
+void AST::pre_post(PreCallback &&pre_callback, PostCallback &&post_callback) const {
+    struct Frame {
+        NodeId id;
+        const NodeId *next_child;
+        const NodeId *end_child;
+    };
+
+    auto frame_of = [this](NodeId id) -> Frame {
+        auto &node = tree->nodes[id];
+        auto first = tree->child_ids.data() + node.first_child;
+        return {id, first, first + node.child_count};
+    };
+
+    // The frames of the first levels live on the call stack, so only walks of deep trees allocate
+    constexpr std::size_t shallow_depth = 32;
+    Frame shallow[shallow_depth];
+    std::vector<Frame> deep;
+    std::size_t depth = 0;
+
+    auto push = [&](NodeId id) {
+        if (depth < shallow_depth)
+            shallow[depth] = frame_of(id);
+        else
+            deep.push_back(frame_of(id));
+        depth++;
+    };
+
+    pre_callback(*this);
+    push(id);
+    while (depth > 0) {
+        auto &frame = depth <= shallow_depth ? shallow[depth - 1] : deep.back();
+        if (frame.next_child != frame.end_child) {
+            NodeId child = *frame.next_child++;
+            pre_callback(AST{tree, child});
+            push(child);
+        } else {
+            post_callback(AST{tree, frame.id});
+            if (--depth >= shallow_depth)
+                deep.pop_back();
+        }
+    }
+}
@@ -1,781 +1,1343 @@
-#include <iostream>
-#include <string>
-#include <vector>
-#include <fstream>
-#include <algorithm>
-
-#include "code_gen.h"
-
-/**
- * I'm sorry if you have to read this code
- */
-
-int Label::counter = 0;
-int Global::counter = 0;
-int StrGlobal::counter = 0;
-
-std::vector<std::string> break_stack;
-std::string current_func;
-int current_offset;
-
-std::map<void*, std::string> vars = {};
-
-auto empty_string = StrGlobal();
-std::map<std::string, std::string> global_to_string = {
-		{empty_string.to_string(), ""}
-};
-std::map<std::string, std::string> string_to_global = {
-		{"", empty_string.to_string()}
-};
-
-std::vector<std::string> all_registers {
-		"$s9",
-		"$s8",
-		"$s7",
-		"$s6",
-		"$s5",
-		"$s4",
-		"$s3",
-		"$s2",
-		"$s1",
-		"$s0",
-		"$t9",
-		"$t8",
-		"$t7",
-		"$t6",
-		"$t5",
-		"$t4",
-		"$t3",
-		"$t2",
-		"$t1",
-		"$t0",
-};
-std::map<std::string, std::vector<std::string>> available_registers {};
-std::vector<std::string> used_registers {};
-
-std::map<std::string, bool> redefined = {
-		{"getchar", false},
-		{"halt", false},
-		{"len", false},
-		{"printb", false},
-		{"printc", false},
-		{"printi", false},
-		{"prints", false},
-		{"divmodchk", false},
-		{"error", false},
-};
-
-
-void populate_registers(std::string func){
-	available_registers[func].clear();
-	for (auto r : all_registers) {
-		available_registers[func].push_back(r);
-	}
-}
-
-std::string alloc_reg(){
-	if (available_registers.find(current_func) == available_registers.end()) {
-		populate_registers(current_func);
-		used_registers.clear();
-	}
-
-	if (!available_registers[current_func].empty()) {
-		std::string available_reg = available_registers[current_func].back();
-		available_registers[current_func].pop_back();
-		used_registers.push_back(available_reg);
-		return available_reg;
-	}
-
-	else {
-		std::cerr << "error: not enough free registers" << std::endl;
-		exit(1);
-	}
-}
-
-void freereg(std::string reg){
-	if(std::find(available_registers[current_func].begin(), available_registers[current_func].end(), reg) != available_registers[current_func].end()) {
-		return;
-	}
-
-	available_registers[current_func].push_back(reg);
-	used_registers.erase(std::remove(used_registers.begin(), used_registers.end(), reg), used_registers.end());
-}
-
-void emit(std::string line) {
-	std::cout << line << std::endl;
-}
-
-void gen_pass_0(AST *ast) {
-	if (ast->type == "program") {
-		for (auto child: ast->children) {
-			gen_pass_0(child);
-		}
-	} else if (ast->type == "globalvar") {
-		auto global = Global();
-		emit("    .data");
-		emit(global.to_string() + ":");
-		if (ast->get_child(1)->attr == "string") {
-			emit("    .word S0");
-		} else {
-			emit("    .word 0");
-		}
-		emit("    .text");
-		vars[ast->sym] = global.to_string();
-	}
-}
-
-void gen_pass_1(AST *ast, bool in_call = false) {
-	if (ast->type == "program") {
-		for (auto child: ast->children) {
-			gen_pass_1(child);
-		}
-	}
-
-	else if (ast->type == "func") {
-		// Update current function
-		current_func = ast->get_child(0)->attr;
-
-		// Check if overwriting predefined function
-		if(redefined.count(ast->get_child(0)->attr)) {
-			redefined[ast->get_child(0)->attr] = true;
-		}
-
-		// Setup stack frame
-		emit(ast->get_child(0)->attr + ":");
-		auto locals = count_locals(ast->get_child(2));
-		auto formals = ast->get_child(1)->get_child(0)->children.size();
-		auto frame_size = (locals + formals) * 4 + 4;
-		emit("    subu $sp,$sp," + std::to_string(frame_size));
-		emit("    sw $ra,0($sp)");
-
-		// Store parameters
-		int i = 0;
-		current_offset = 4;
-		for(auto formal : ast->get_child(1)->get_child(0)->children) {
-			auto offset = i * 4 + 4;
-			emit("    sw $a" + std::to_string(i) + "," + std::to_string(current_offset) + "($sp)");
-			vars[formal->get_child(0)->sym] = std::to_string(offset) + "($sp)";
-			current_offset += 4;
-			i++;
-		}
-
-		// Body
-		gen_pass_1(ast->get_child(2));
-
-		// Return validation
-		if(ast->get_child(1)->get_child(1)->attr != "$void") {
-			auto error_string = "error: function \'" + ast->get_child(0)->attr + "\' must return a value\n";
-			auto error_string_global = StrGlobal();
-			string_to_global[error_string] = error_string_global.to_string();
-			global_to_string[error_string_global.to_string()] = error_string;
-			emit("    la $a0," + error_string_global.to_string());
-			emit("    j error");
-		}
-
-		// Epilogue
-		emit(ast->get_child(0)->attr + "_epilogue:");
-		emit("    lw $ra,0($sp)");
-		emit("    addu $sp,$sp," + std::to_string(frame_size));
-		emit("    jr $ra");
-	}
-
-	else if (ast->type == "funccall") {
-		// Calculate parameters
-		int i = 0;
-		for(auto actual : ast->get_child(1)->children) {
-			gen_pass_1(actual, true);
-			i++;
-		}
-		for(auto actual : ast->get_child(1)->children) {
-			freereg(actual->reg);
-		}
-
-		// Save registers
-		auto saved_available = available_registers;
-		auto saved = used_registers;
-		if(in_call) {
-			emit("    subu $sp,$sp," + std::to_string(saved.size() * 4));
-			i = 0;
-			for(auto reg : saved) {
-				emit("    sw " + reg + "," + std::to_string(i * 4) + "($sp)");
-				freereg(reg);
-				i++;
-			}
-		}
-
-		// Store parameters
-		i = 0;
-		for(auto actual : ast->get_child(1)->children) {
-			emit("    move $a" + std::to_string(i) + "," + actual->reg);
-			freereg(actual->reg);
-			i++;
-		}
-		emit("    jal " + ast->get_child(0)->attr);
-
-		// Load registers
-		if(in_call) {
-			i = 0;
-			available_registers = saved_available;
-			used_registers = saved;
-			for (auto reg: saved) {
-				emit("    lw " + reg + "," + std::to_string(i * 4) + "($sp)");
-				i++;
-			}
-			emit("    addu $sp,$sp," + std::to_string(saved.size() * 4));
-		}
-
-		// Save output
-		auto reg = alloc_reg();
-		ast->reg = reg;
-		emit("    move " + reg + ",$v0");
-
-		// Free register if not in call (holy smokes this is hot garbage
-		if(!in_call) {
-			freereg(reg);
-		}
-	}
-
-	else if (ast->type == "var") {
-		if(ast->get_child(1)->attr == "string") {
-			emit("    la $v1,S0");
-			emit("    sw $v1," + std::to_string(current_offset) + "($sp)");
-		} else {
-			emit("    sw $0," + std::to_string(current_offset) + "($sp)");
-		}
-		vars[ast->sym] = std::to_string(current_offset) + "($sp)";
-		current_offset += 4;
-	}
-
-	else if (ast->type == "block") {
-		for (auto child: ast->children) {
-			gen_pass_1(child);
-		}
-		populate_registers(current_func);
-		used_registers.clear();
-	}
-
-	else if (ast->type == "if") {
-		auto elze = Label();
-		auto end = Label();
-
-		// Condition
-		gen_pass_1(ast->get_child(0));
-		if(ast->children.size() == 3) {
-			emit("    beqz " + ast->get_child(0)->reg + "," + elze.to_string());
-		} else {
-			emit("    beqz " + ast->get_child(0)->reg + "," + end.to_string());
-		}
-		freereg(ast->get_child(0)->reg);
-
-		// If body
-		gen_pass_1(ast->get_child(1));
-		emit("    j " + end.to_string());
-
-		// Else body
-		if(ast->children.size() == 3) {
-			emit(elze.to_string() + ":");
-			gen_pass_1(ast->get_child(2));
-		}
-
-		// End of loop
-		emit(end.to_string() + ":");
-	}
-
-	else if (ast->type == "else") {
-		// Condition
-		gen_pass_1(ast->get_child(0));
-	}
-
-	else if (ast->type == "for") {
-		auto start = Label();
-		auto end = Label();
-		break_stack.push_back(end.to_string());
-
-		// Start of loop
-		emit(start.to_string() + ":");
-
-		// Condition
-		gen_pass_1(ast->get_child(0));
-		emit("    beqz " + ast->get_child(0)->reg + "," + end.to_string());
-		freereg(ast->get_child(0)->reg);
-
-		// Body
-		gen_pass_1(ast->get_child(1));
-		emit("    j " + start.to_string());
-
-		// End of loop
-		emit(end.to_string() + ":");
-		break_stack.pop_back();
-	}
-
-	else if (ast->type == "break") {
-		emit("    j " + break_stack.back());
-	}
-
-	else if (ast->type == "return") {
-		if (!ast->children.empty()) {
-			gen_pass_1(ast->get_child(0));
-			emit("    move $v0," + ast->get_child(0)->reg);
-		}
-		emit("    j " + current_func + "_epilogue");
-	}
-
-	else if (ast->type == "int") {
-		auto reg = alloc_reg();
-		ast->reg = reg;
-		emit("    li " + reg + "," + ast->attr);
-	}
-
-	else if (ast->type == "u-") {
-		gen_pass_1(ast->get_child(0));
-		emit("    negu " + ast->get_child(0)->reg + "," + ast->get_child(0)->reg);
-		ast->reg = ast->get_child(0)->reg;
-	}
-
-	else if (ast->type == "string") {
-		auto reg = alloc_reg();
-		ast->reg = reg;
-		std::string str_global;
-		auto normalized = (ast->attr == "\\t" || ast->attr == "\t") ? "\t" : ast->attr;
-		if(string_to_global.count(normalized)) {
-			str_global = string_to_global[normalized];
-		} else {
-			str_global = StrGlobal().to_string();
-		}
-		emit("    la " + reg + "," + str_global);
-		global_to_string[str_global] = normalized;
-		string_to_global[normalized] = str_global;
-	}
-
-	else if (ast->type == "id") {
-		auto reg = alloc_reg();
-		ast->reg = reg;
-		if (ast->attr == "true" || ast->attr == "$true") {
-			emit("    li " + reg + ",Ltrue");
-		} else if (ast->attr == "false" && ast->sym->sig == "bool") {
-			emit("    li " + reg + ",Lfalse");
-		} else {
-			emit("    lw " + reg + "," + vars[ast->sym]);
-		}
-	}
-
-	else if (ast->type == "&&") {
-		gen_pass_1(ast->get_child(0));
-		auto reg = alloc_reg();
-		ast->reg = reg;
-		emit("    move " + reg + "," + ast->get_child(0)->reg);
-		auto skip = Label();
-		emit("    beqz " + reg + "," + skip.to_string());
-		freereg(ast->get_child(0)->reg);
-		gen_pass_1(ast->get_child(1));
-		emit("    move " + reg + "," + ast->get_child(0)->reg);
-		freereg(ast->get_child(1)->reg);
-		emit(skip.to_string() + ":");
-	}
-
-	else if (ast->type == "||") {
-		gen_pass_1(ast->get_child(0));
-		auto reg = alloc_reg();
-		ast->reg = reg;
-		emit("    move " + reg + "," + ast->get_child(0)->reg);
-		auto skip = Label();
-		emit("    bnez " + reg + "," + skip.to_string());
-		freereg(ast->get_child(0)->reg);
-		gen_pass_1(ast->get_child(1));
-		emit("    move " + reg + "," + ast->get_child(0)->reg);
-		freereg(ast->get_child(1)->reg);
-		emit(skip.to_string() + ":");
-	}
-
-	else if (ast->type == "==") {
-		gen_pass_1(ast->get_child(0), true);
-		gen_pass_1(ast->get_child(1), true);
-		auto reg = alloc_reg();
-		ast->reg = reg;
-		emit("    seq " + reg + "," + ast->get_child(0)->reg + "," + ast->get_child(1)->reg);
-		freereg(ast->get_child(1)->reg);
-		freereg(ast->get_child(0)->reg);
-	}
-
-	else if (ast->type == "!=") {
-		gen_pass_1(ast->get_child(0), true);
-		gen_pass_1(ast->get_child(1), true);
-		auto reg = alloc_reg();
-		ast->reg = reg;
-		emit("    sne " + reg + "," + ast->get_child(0)->reg + "," + ast->get_child(1)->reg);
-		freereg(ast->get_child(1)->reg);
-		freereg(ast->get_child(0)->reg);
-	}
-
-	else if (ast->type == ">=") {
-		gen_pass_1(ast->get_child(0), true);
-		gen_pass_1(ast->get_child(1), true);
-		auto reg = alloc_reg();
-		ast->reg = reg;
-		emit("    sge " + reg + "," + ast->get_child(0)->reg + "," + ast->get_child(1)->reg);
-		freereg(ast->get_child(1)->reg);
-		freereg(ast->get_child(0)->reg);
-	}
-
-	else if (ast->type == ">") {
-		gen_pass_1(ast->get_child(0), true);
-		gen_pass_1(ast->get_child(1), true);
-		auto reg = alloc_reg();
-		ast->reg = reg;
-		emit("    sgt " + reg + "," + ast->get_child(0)->reg + "," + ast->get_child(1)->reg);
-		freereg(ast->get_child(1)->reg);
-		freereg(ast->get_child(0)->reg);
-	}
-
-	else if (ast->type == "<=") {
-		gen_pass_1(ast->get_child(0), true);
-		gen_pass_1(ast->get_child(1), true);
-		auto reg = alloc_reg();
-		ast->reg = reg;
-		emit("    sle " + reg + "," + ast->get_child(0)->reg + "," + ast->get_child(1)->reg);
-		freereg(ast->get_child(1)->reg);
-		freereg(ast->get_child(0)->reg);
-	}
-
-	else if (ast->type == "<") {
-		gen_pass_1(ast->get_child(0), true);
-		gen_pass_1(ast->get_child(1), true);
-		auto reg = alloc_reg();
-		ast->reg = reg;
-		emit("    slt " + reg + "," + ast->get_child(0)->reg + "," + ast->get_child(1)->reg);
-		freereg(ast->get_child(1)->reg);
-		freereg(ast->get_child(0)->reg);
-	}
-
-	else if (ast->type == "*") {
-		gen_pass_1(ast->get_child(0), true);
-		gen_pass_1(ast->get_child(1), true);
-		auto reg = alloc_reg();
-		ast->reg = reg;
-		emit("    mul " + reg + "," + ast->get_child(0)->reg + "," + ast->get_child(1)->reg);
-		freereg(ast->get_child(1)->reg);
-		freereg(ast->get_child(0)->reg);
-	}
-
-	else if (ast->type == "/") {
-		gen_pass_1(ast->get_child(0), true);
-		gen_pass_1(ast->get_child(1), true);
-		emit("    move $a0," + ast->get_child(0)->reg);
-		emit("    move $a1," + ast->get_child(1)->reg);
-		emit("    jal divmodchk");
-		emit("    move " + ast->get_child(1)->reg + ",$v0");
-		auto reg = alloc_reg();
-		ast->reg = reg;
-		emit("    div " + reg + "," + ast->get_child(0)->reg + "," + ast->get_child(1)->reg);
-		freereg(ast->get_child(1)->reg);
-		freereg(ast->get_child(0)->reg);
-	}
-
-	else if (ast->type == "%") {
-		gen_pass_1(ast->get_child(0), true);
-		gen_pass_1(ast->get_child(1), true);
-		emit("    move $a0," + ast->get_child(0)->reg);
-		emit("    move $a1," + ast->get_child(1)->reg);
-		emit("    jal divmodchk");
-		emit("    move " + ast->get_child(1)->reg + ",$v0");
-		auto reg = alloc_reg();
-		ast->reg = reg;
-		emit("    rem " + reg + "," + ast->get_child(0)->reg + "," + ast->get_child(1)->reg);
-		freereg(ast->get_child(1)->reg);
-		freereg(ast->get_child(0)->reg);
-	}
-
-	else if (ast->type == "+") {
-		gen_pass_1(ast->get_child(0), true);
-		gen_pass_1(ast->get_child(1), true);
-		auto reg = alloc_reg();
-		ast->reg = reg;
-		emit("    addu " + reg + "," + ast->get_child(0)->reg + "," + ast->get_child(1)->reg);
-		freereg(ast->get_child(1)->reg);
-		freereg(ast->get_child(0)->reg);
-	}
-
-	else if (ast->type == "-") {
-		gen_pass_1(ast->get_child(0), true);
-		gen_pass_1(ast->get_child(1), true);
-		auto reg = alloc_reg();
-		ast->reg = reg;
-		emit("    subu " + reg + "," + ast->get_child(0)->reg + "," + ast->get_child(1)->reg);
-		freereg(ast->get_child(1)->reg);
-		freereg(ast->get_child(0)->reg);
-	}
-
-	else if (ast->type == "!") {
-		gen_pass_1(ast->get_child(0), true);
-		freereg(ast->get_child(0)->reg);
-		auto reg = alloc_reg();
-		ast->reg = reg;
-		emit("    xori " + reg + "," + ast->get_child(0)->reg + ",1");
-	}
-
-	else if (ast->type == "=") {
-		gen_pass_1(ast->get_child(1), true);
-		emit("    sw " + ast->get_child(1)->reg + "," + vars[ast->get_child(0)->sym]);
-		freereg		(ast->get_child(1)->reg);
-	}
-}
-
-int count_locals(AST *ast) {
-	int count = 0;
-	if (ast->type == "var") {
-		count++;
-	} else if (ast->type == "block") {
-		for (auto child: ast->children) {
-			count += count_locals(child);
-		}
-	} else if (ast->type == "if") {
-		count += count_locals(ast->get_child(1));
-		if (ast->children.size() == 3) {
-			count += count_locals(ast->get_child(2)->get_child(0));
-		}
-	} else if (ast->type == "for") {
-		count += count_locals(ast->get_child(1));
-	}
-	return count;
-}
-
-void gen_pass_2() {
-	std::map<char, char> escapes = {
-		{'b' , '\b'},
-		{'t' , '\t' },
-		{'n' , '\n' },
-		{'f' , '\f' },
-		{'r' , '\r' },
-		{'"' , '"' },
-		{'\'', '\'' },
-		{'\\' , '\\' },
-	};
-
-	if (global_to_string.empty()) {
-		return;
-	}
-
-	// Sort strings by length
-	std::vector<std::pair<std::string, std::string>> sorted;
-	for (auto it = global_to_string.begin(); it != global_to_string.end(); it++) {
-		sorted.push_back(*it);
-	}
-	std::sort(sorted.begin(), sorted.end(), [](std::pair<std::string, std::string>& a, std::pair<std::string, std::string>& b)
-	{
-		if (a.second.length() == b.second.length()) { // If length is the same
-			int cmp = a.second.compare(b.second); // Compare alphabetically
-			if (cmp == 0) { // If they are the same alphabetically
-				// Compare case-insensitively
-				return std::lexicographical_compare(a.second.begin(), a.second.end(), b.second.begin(), b.second.end(),
-													[](char a, char b) { return std::tolower(a) < std::tolower(b); });
-			} else {
-				return cmp < 0;
-			}
-		} else {
-			return a.second.length() < b.second.length();
-		}
-	});
-
-	emit("    .data");
-	auto escaping = false;
-	for (auto &[label, value]: sorted) {
-		emit(label + ":");
-		for (char &c: value) {
-			if(c == 92 && !escaping) {
-				escaping = true;
-			} else if(escaping && escapes.count(c)) {
-				emit("    .byte " + std::to_string(escapes[c]));
-				escaping = false;
-			} else {
-				emit("    .byte " + std::to_string(int(c)));
-			}
-		}
-		emit("    .byte 0");
-	}
-	emit("    .align 2");
-	emit("    .text");
-}
-
-void generate_code(AST *root) {
-	emit("    Ltrue = 1");
-	emit("    Lfalse = 0");
-	emit("    .text");
-	emit("    .globl _start");
-	emit("_start:");
-	emit("    jal main");
-	emit("    j halt");
-
-	// Populate the globals
-	gen_pass_0(root);
-
-	// Majority of the code generation
-	gen_pass_1(root);
-
-	// Populate predefined functions
-	get_char();
-	prints();
-	printi();
-	halt();
-	printb();
-	printc();
-	len();
-	divmodchk();
-	error();
-
-	// String tomfoolery
-	gen_pass_2();
-}
-
-void get_char(){
-	if(redefined["getchar"])
-		return;
-
-	emit("    .data");
-	emit("    char: .space 2");
-	emit("    .text");
-	emit("getchar:");
-	emit("    addi $sp,$sp,-4");
-	emit("    sw $s0,0($sp)");
-	emit("    li $v0,8");
-	emit("    la $a0,char");
-	emit("    la $a1,2");
-	emit("    syscall");
-	emit("    lb $v0,char");
-	emit("    li $s0,4");
-	emit("    beq $v0,$s0,getchar_eof");
-	emit("    li $s0,0");
-	emit("    beq $v0,$s0,getchar_eof");
-	emit("getchar_epilogue:");
-	emit("    lw $s0,0($sp)");
-	emit("    addi $sp,$sp,4");
-	emit("    jr $ra ");
-	emit("getchar_eof:");
-	emit("    li $v0,-1");
-	emit("    j getchar_epilogue");
-}
-
-void prints(){
-	if(redefined["prints"])
-		return;
-
-	emit("prints:");
-	emit("    li $v0,4");
-	emit("    syscall");
-	emit("    jr $ra ");
-}
-
-void printi(){
-	if(redefined["printi"])
-		return;
-
-	emit("printi:");
-	emit("    li $v0,1");
-	emit("    syscall");
-	emit("    jr $ra ");
-
-}
-
-void halt(){
-	if(redefined["halt"])
-		return;
-
-	emit("halt:");
-	emit("    li $v0,10");
-	emit("    syscall");
-	emit("    jr $ra ");
-
-}
-
-void printb(){
-	if(redefined["printb"])
-		return;
-
-	auto t = StrGlobal();
-	auto f = StrGlobal();
-
-	string_to_global["true"] = t.to_string();
-	global_to_string[t.to_string()] = "true";
-	string_to_global["false"] = f.to_string();
-	global_to_string[f.to_string()] = "false";
-
-	emit("printb:");
-	emit("	  li $t0,1");
-	emit("	  beq $a0,$zero,printb_false");
-	emit("	  la $a0," + t.to_string());
-	emit("	  j printb_epilogue");
-	emit("printb_false:");
-	emit("	  la $a0," + f.to_string());
-	emit("printb_epilogue:");
-	emit("	  li $v0,4");
-	emit("	  syscall");
-	emit("	  jr $ra");
-}
-
-void printc(){
-	if(redefined["printc"])
-		return;
-
-	emit("printc:");
-	emit("    li $v0,11");
-	emit("    syscall");
-	emit("    jr $ra ");
-}
-
-void len(){
-	if(redefined["len"])
-		return;
-
-	emit("len:");
-	emit("    subu $sp,$sp,8");
-	emit("    sw $ra,0($sp)");
-	emit("    sw $a0,4($sp)");
-	emit("    li $t0,0");
-	emit("len_loop:");
-	emit("    lb $t1,0($a0)");
-	emit("    beqz $t1,len_epilogue");
-	emit("    addi $a0,$a0,1");
-	emit("    addi $t0,$t0,1");
-	emit("    j len_loop");
-	emit("len_epilogue:");
-	emit("    move $v0,$t0");
-	emit("    lw $ra,0($sp)");
-	emit("    addu $sp,$sp,8");
-	emit("    jr $ra ");
-}
-
-void divmodchk(){
-	if(redefined["divmodchk"])
-		return;
-
-	auto err = StrGlobal();
-	global_to_string[err.to_string()] = "error: division by zero\n";
-
-	emit("divmodchk:");
-	emit("    subu $sp,$sp,12");
-	emit("    sw $ra,0($sp)");
-	emit("    sw $a0,4($sp)");
-	emit("    sw $a1,8($sp)");
-	emit("    bne $a1,$zero,divmodchk_min");
-	emit("    la $a0," + err.to_string());
-	emit("    li $v0,4");
-	emit("    syscall");
-	emit("    j halt");
-	emit("divmodchk_min:");
-	emit("    bne $a0,-2147483648,divmodchk_epilogue");
-	emit("    li $a1,1");
-	emit("divmodchk_epilogue:");
-	emit("    move $v0,$a1");
-	emit("    lw $ra,0($sp)");
-	emit("    addu $sp,$sp,12");
-	emit("    jr $ra ");
-}
-
-void error(){
-	if(redefined["error"])
-		return;
-
-	emit("error:");
-	emit("    li $v0,4");
-	emit("    syscall");
-	emit("    j halt");
-}
\ No newline at end of file
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <limits>
+
+#include "code_gen.h"
+#include "frame.h"
+#include "inliner.h"
+#include "peephole.h"
+#include "register_allocator.h"
+
+/**
+ * I'm sorry if you have to read this code
+ */
+
+const std::vector<Reg> all_registers {
+		Reg::S8,
+		Reg::S7,
+		Reg::S6,
+		Reg::S5,
+		Reg::S4,
+		Reg::S3,
+		Reg::S2,
+		Reg::S1,
+		Reg::S0,
+		Reg::T9,
+		Reg::T8,
+		Reg::T7,
+		Reg::T6,
+		Reg::T5,
+		Reg::T4,
+		Reg::T3,
+		Reg::T2,
+		Reg::T1,
+		Reg::T0,
+};
+
+/**
+ * CodeGen class constructor
+ * The empty string is always the first string global, since uninitialized string variables point at it
+ * @param out the stream to write the assembly to
+ * @param options the options of the generated code
+ */
+CodeGen::CodeGen(std::ostream &out, CodeGenOptions options) : writer(out), options(options) {
+	auto empty_string = StrGlobal(str_globals++);
+	global_to_string[empty_string.to_string()] = "";
+	string_to_global[""] = empty_string;
+}
+
+void CodeGen::populate_registers(){
+	available = all_registers;
+}
+
+Reg CodeGen::alloc_reg(){
+	// With optimization every value gets its own register, the register allocator assigns machine registers later
+	if (options.level >= 1)
+		return virtual_register(virtual_registers++);
+
+	if (!available) {
+		populate_registers();
+		used_registers.clear();
+	}
+
+	if (!available->empty()) {
+		Reg available_reg = available->back();
+		available->pop_back();
+		used_registers.push_back(available_reg);
+		return available_reg;
+	}
+
+	else {
+		// Print what was generated so far, as if it had been written out line by line
+		for (auto &function: functions)
+			print(function, writer);
+		writer.flush();
+		std::cerr << "error: not enough free registers" << std::endl;
+		exit(1);
+	}
+}
+
+void CodeGen::freereg(Reg reg){
+	if (options.level >= 1)
+		return;
+	if (!available)
+		available.emplace();
+	if(std::find(available->begin(), available->end(), reg) != available->end()) {
+		return;
+	}
+
+	available->push_back(reg);
+	used_registers.erase(std::remove(used_registers.begin(), used_registers.end(), reg), used_registers.end());
+}
+
+/**
+ * Appends an instruction to the function being lowered
+ * @param instruction the instruction
+ */
+void CodeGen::append(const Instruction &instruction) {
+	functions.back().append(instruction);
+}
+
+/**
+ * Places a label at the current point of the function being lowered
+ * @param label the label
+ */
+void CodeGen::place(Name label) {
+	functions.back().place(label);
+}
+
+void CodeGen::gen_pass_0(AST ast) {
+	switch (ast.kind()) {
+		case NodeKind::Program: {
+			for (auto child: ast.children()) {
+				gen_pass_0(child);
+			}
+			break;
+		}
+		case NodeKind::GlobalVar: {
+			auto global = Global(globals++);
+			emit("    .data");
+			emit(global, ":");
+			if (ast.get_child(1).attr() == "string") {
+				emit("    .word S0");
+			} else {
+				emit("    .word 0");
+			}
+			emit("    .text");
+			vars[ast.sym()] = Address{global};
+			break;
+		}
+		default:
+			break;
+	}
+}
+
+/**
+ * Lowers the functions of the tree to instructions, grouped into blocks
+ * Registers are handed out as the tree is walked, so the instructions use machine registers from the start
+ * @param ast the node to lower
+ * @param in_call whether the node is an operand, whose registers must survive nested calls
+ */
+void CodeGen::gen_pass_1(AST ast, bool in_call) {
+	switch (ast.kind()) {
+		case NodeKind::Program: {
+			for (auto child: ast.children()) {
+				gen_pass_1(child);
+			}
+			break;
+		}
+		case NodeKind::Func: {
+			// Update current function
+			auto name = ast.get_child(0).attr();
+			current_func = name;
+			available.reset();
+			virtual_registers = 0;
+			functions.push_back({name});
+
+			// Check if overwriting predefined function
+			if(redefined.count(std::string(name))) {
+				redefined[std::string(name)] = true;
+			}
+
+			// Setup stack frame
+			place(Name::function(name));
+			auto locals = count_locals(ast.get_child(2));
+			auto formals = ast.get_child(1).get_child(0).children().size();
+			auto frame_size = (locals + formals) * 4 + 4;
+			// With optimization locals and formals live in registers, so the frame only holds $ra, and it is only
+			// made on the paths that need it once the registers are allocated (see `build_frame`)
+			if (options.level >= 1) {
+				functions.back().frame_size = 4;
+			} else {
+				append(Instruction::rri(Opcode::Subu, Reg::Sp, Reg::Sp, frame_size));
+				append(Instruction::store(Reg::Ra, {{}, Reg::Sp, 0}));
+			}
+
+			// Store parameters
+			int i = 0;
+			current_offset = 4;
+			for(auto formal : ast.get_child(1).get_child(0).children()) {
+				if (options.level >= 1) {
+					auto reg = alloc_reg();
+					append(Instruction::rr(Opcode::Move, reg, argument(i)));
+					promoted[formal.get_child(0).sym()] = reg;
+					i++;
+					continue;
+				}
+				auto offset = i * 4 + 4;
+				append(Instruction::store(argument(i), {{}, Reg::Sp, current_offset}));
+				vars[formal.get_child(0).sym()] = Address{{}, Reg::Sp, offset};
+				current_offset += 4;
+				i++;
+			}
+
+			// Body
+			gen_pass_1(ast.get_child(2));
+
+			// Return validation
+			check_return(ast);
+
+			// Epilogue
+			place(Name::epilogue(name));
+			if (options.level == 0) {
+				append(Instruction::load(Reg::Ra, {{}, Reg::Sp, 0}));
+				append(Instruction::rri(Opcode::Addu, Reg::Sp, Reg::Sp, frame_size));
+			}
+			append(Instruction::jr(Reg::Ra));
+			break;
+		}
+		case NodeKind::FuncCall: {
+			// Small functions are expanded in place with optimization
+			auto callee = inlined.find(ast.get_child(0).attr());
+			if (callee != inlined.end()) {
+				expand_call(ast, callee->second);
+				break;
+			}
+
+			// Calculate parameters
+			int i = 0;
+			for(auto actual : ast.get_child(1).children()) {
+				gen_pass_1(actual, true);
+				i++;
+			}
+			for(auto actual : ast.get_child(1).children()) {
+				freereg(actual.reg());
+			}
+
+			// Save registers, with optimization the register allocator saves the registers that are live across the call
+			in_call = in_call && options.level == 0;
+			auto saved_available = available;
+			auto saved = used_registers;
+			if(in_call) {
+				append(Instruction::rri(Opcode::Subu, Reg::Sp, Reg::Sp, saved.size() * 4));
+				i = 0;
+				for(auto reg : saved) {
+					append(Instruction::store(reg, {{}, Reg::Sp, i * 4}));
+					freereg(reg);
+					i++;
+				}
+			}
+
+			// Store parameters
+			i = 0;
+			for(auto actual : ast.get_child(1).children()) {
+				append(Instruction::rr(Opcode::Move, argument(i), actual.reg()));
+				freereg(actual.reg());
+				i++;
+			}
+			append(Instruction::jump(Opcode::Jal, Name::function(ast.get_child(0).attr())));
+
+			// Load registers
+			if(in_call) {
+				i = 0;
+				available = saved_available;
+				used_registers = saved;
+				for (auto reg: saved) {
+					append(Instruction::load(reg, {{}, Reg::Sp, i * 4}));
+					i++;
+				}
+				append(Instruction::rri(Opcode::Addu, Reg::Sp, Reg::Sp, saved.size() * 4));
+			}
+
+			// Save output
+			auto reg = alloc_reg();
+			ast.reg() = reg;
+			append(Instruction::rr(Opcode::Move, reg, Reg::V0));
+
+			// Free register if not in call (holy smokes this is hot garbage
+			if(!in_call) {
+				freereg(reg);
+			}
+			break;
+		}
+		case NodeKind::Var: {
+			if (options.level >= 1) {
+				auto reg = alloc_reg();
+				if (ast.get_child(1).attr() == "string")
+					append(Instruction::rn(Opcode::La, reg, StrGlobal(0)));
+				else
+					append(Instruction::rn(Opcode::Li, reg, Name::literal("0")));
+				promoted[ast.sym()] = reg;
+				break;
+			}
+			if(ast.get_child(1).attr() == "string") {
+				append(Instruction::rn(Opcode::La, Reg::V1, StrGlobal(0)));
+				append(Instruction::store(Reg::V1, {{}, Reg::Sp, current_offset}));
+			} else {
+				append(Instruction::store(Reg::Zero, {{}, Reg::Sp, current_offset}));
+			}
+			vars[ast.sym()] = Address{{}, Reg::Sp, current_offset};
+			current_offset += 4;
+			break;
+		}
+		case NodeKind::Block: {
+			for (auto child: ast.children()) {
+				gen_pass_1(child);
+			}
+			populate_registers();
+			used_registers.clear();
+			break;
+		}
+		case NodeKind::If: {
+			// Chains that compare one variable with int literals go straight to the arm of its value, with optimization
+			if (options.level >= 1 && dispatch(ast))
+				break;
+
+			auto elze = Label(labels++);
+			auto end = Label(labels++);
+
+			// Condition
+			gen_pass_1(ast.get_child(0));
+			if(ast.children().size() == 3) {
+				append(Instruction::branch(Opcode::Beqz, ast.get_child(0).reg(), elze));
+			} else {
+				append(Instruction::branch(Opcode::Beqz, ast.get_child(0).reg(), end));
+			}
+			freereg(ast.get_child(0).reg());
+
+			// If body
+			gen_pass_1(ast.get_child(1));
+			append(Instruction::jump(Opcode::J, end));
+
+			// Else body
+			if(ast.children().size() == 3) {
+				place(elze);
+				gen_pass_1(ast.get_child(2));
+			}
+
+			// End of loop
+			place(end);
+			break;
+		}
+		case NodeKind::Else: {
+			// Condition
+			gen_pass_1(ast.get_child(0));
+			break;
+		}
+		case NodeKind::For: {
+			auto start = Label(labels++);
+			auto end = Label(labels++);
+			break_stack.push_back(end);
+
+			// Start of loop
+			place(start);
+
+			// Condition
+			gen_pass_1(ast.get_child(0));
+			append(Instruction::branch(Opcode::Beqz, ast.get_child(0).reg(), end));
+			freereg(ast.get_child(0).reg());
+
+			// Body
+			gen_pass_1(ast.get_child(1));
+			append(Instruction::jump(Opcode::J, start));
+
+			// End of loop
+			place(end);
+			break_stack.pop_back();
+			break;
+		}
+		case NodeKind::Break: {
+			append(Instruction::jump(Opcode::J, break_stack.back()));
+			break;
+		}
+		case NodeKind::Return: {
+			// Returning from a call that is expanded in place goes past the expansion instead
+			if (!expansions.empty()) {
+				if (!ast.children().empty()) {
+					gen_pass_1(ast.get_child(0));
+					append(Instruction::rr(Opcode::Move, expansions.back().result, ast.get_child(0).reg()));
+				}
+				append(Instruction::jump(Opcode::J, expansions.back().end));
+				break;
+			}
+			if (!ast.children().empty()) {
+				gen_pass_1(ast.get_child(0));
+				append(Instruction::rr(Opcode::Move, Reg::V0, ast.get_child(0).reg()));
+			}
+			append(Instruction::jump(Opcode::J, Name::epilogue(current_func)));
+			break;
+		}
+		case NodeKind::Int: {
+			auto reg = alloc_reg();
+			ast.reg() = reg;
+			append(Instruction::rn(Opcode::Li, reg, Name::literal(ast.attr())));
+			break;
+		}
+		case NodeKind::Negate: {
+			gen_pass_1(ast.get_child(0), in_call);
+			// The operand may be the register of a local with optimization, which must not be overwritten
+			auto reg = options.level >= 1 ? alloc_reg() : ast.get_child(0).reg();
+			append(Instruction::rr(Opcode::Negu, reg, ast.get_child(0).reg()));
+			ast.reg() = reg;
+			break;
+		}
+		case NodeKind::String: {
+			auto reg = alloc_reg();
+			ast.reg() = reg;
+			Name str_global;
+			auto normalized = (ast.attr() == "\\t" || ast.attr() == "\t") ? "\t" : std::string(ast.attr());
+			if(string_to_global.count(normalized)) {
+				str_global = string_to_global[normalized];
+			} else {
+				str_global = StrGlobal(str_globals++);
+			}
+			append(Instruction::rn(Opcode::La, reg, str_global));
+			global_to_string[str_global.to_string()] = normalized;
+			string_to_global[normalized] = str_global;
+			break;
+		}
+		case NodeKind::Id: {
+			// Locals and formals are read straight from their registers with optimization
+			if (promoted.count(ast.sym())) {
+				ast.reg() = promoted[ast.sym()];
+				break;
+			}
+			auto reg = alloc_reg();
+			ast.reg() = reg;
+			if (ast.attr() == "true" || ast.attr() == "$true") {
+				append(Instruction::rn(Opcode::Li, reg, Name::literal("Ltrue")));
+			} else if (ast.attr() == "false" && ast.sym()->sig == Type::basic(TypeKind::Bool)) {
+				append(Instruction::rn(Opcode::Li, reg, Name::literal("Lfalse")));
+			} else {
+				append(Instruction::load(reg, vars[ast.sym()]));
+			}
+			break;
+		}
+		case NodeKind::And: {
+			// The operands keep their registers like the operands of a call, so the result is read from the right one
+			gen_pass_1(ast.get_child(0), true);
+			auto reg = alloc_reg();
+			ast.reg() = reg;
+			append(Instruction::rr(Opcode::Move, reg, ast.get_child(0).reg()));
+			auto skip = Label(labels++);
+			append(Instruction::branch(Opcode::Beqz, reg, skip));
+			freereg(ast.get_child(0).reg());
+			gen_pass_1(ast.get_child(1), true);
+			append(Instruction::rr(Opcode::Move, reg, ast.get_child(1).reg()));
+			freereg(ast.get_child(1).reg());
+			place(skip);
+			break;
+		}
+		case NodeKind::Or: {
+			// The operands keep their registers like the operands of a call, so the result is read from the right one
+			gen_pass_1(ast.get_child(0), true);
+			auto reg = alloc_reg();
+			ast.reg() = reg;
+			append(Instruction::rr(Opcode::Move, reg, ast.get_child(0).reg()));
+			auto skip = Label(labels++);
+			append(Instruction::branch(Opcode::Bnez, reg, skip));
+			freereg(ast.get_child(0).reg());
+			gen_pass_1(ast.get_child(1), true);
+			append(Instruction::rr(Opcode::Move, reg, ast.get_child(1).reg()));
+			freereg(ast.get_child(1).reg());
+			place(skip);
+			break;
+		}
+		case NodeKind::Equal:
+		case NodeKind::NotEqual:
+		case NodeKind::GreaterEqual:
+		case NodeKind::Greater:
+		case NodeKind::LessEqual:
+		case NodeKind::Less:
+		case NodeKind::Multiply:
+		case NodeKind::Add:
+		case NodeKind::Subtract: {
+			// Multiplying by a literal is done with shifts and adds where that is cheaper, with optimization
+			if (ast.kind() == NodeKind::Multiply && options.level >= 1 && multiply_by_literal(ast))
+				break;
+			gen_pass_1(ast.get_child(0), true);
+			gen_pass_1(ast.get_child(1), true);
+			auto reg = alloc_reg();
+			ast.reg() = reg;
+			append(Instruction::rrr(binary_opcode(ast.kind()), reg, ast.get_child(0).reg(), ast.get_child(1).reg()));
+			freereg(ast.get_child(1).reg());
+			freereg(ast.get_child(0).reg());
+			break;
+		}
+		case NodeKind::Divide:
+		case NodeKind::Modulo: {
+			// A literal divisor is known not to be zero, so it needs no check, with optimization
+			if (options.level >= 1 && divide_by_literal(ast))
+				break;
+			gen_pass_1(ast.get_child(0), true);
+			gen_pass_1(ast.get_child(1), true);
+			append(Instruction::rr(Opcode::Move, Reg::A0, ast.get_child(0).reg()));
+			append(Instruction::rr(Opcode::Move, argument(1), ast.get_child(1).reg()));
+			append(Instruction::jump(Opcode::Jal, Name::function("divmodchk")));
+			auto divisor = options.level >= 1 ? alloc_reg() : ast.get_child(1).reg();
+			append(Instruction::rr(Opcode::Move, divisor, Reg::V0));
+			auto reg = alloc_reg();
+			ast.reg() = reg;
+			append(Instruction::rrr(binary_opcode(ast.kind()), reg, ast.get_child(0).reg(), divisor));
+			freereg(ast.get_child(1).reg());
+			freereg(ast.get_child(0).reg());
+			break;
+		}
+		case NodeKind::Not: {
+			gen_pass_1(ast.get_child(0), true);
+			freereg(ast.get_child(0).reg());
+			auto reg = alloc_reg();
+			ast.reg() = reg;
+			append(Instruction::rri(Opcode::Xori, reg, ast.get_child(0).reg(), 1));
+			break;
+		}
+		case NodeKind::Assign: {
+			gen_pass_1(ast.get_child(1), true);
+			if (promoted.count(ast.get_child(0).sym())) {
+				append(Instruction::rr(Opcode::Move, promoted[ast.get_child(0).sym()], ast.get_child(1).reg()));
+				break;
+			}
+			append(Instruction::store(ast.get_child(1).reg(), vars[ast.get_child(0).sym()]));
+			freereg		(ast.get_child(1).reg());
+			break;
+		}
+		default:
+			break;
+	}
+}
+
+/**
+ * Gets the value of an int literal, wrapped to 32 bits as `li` does
+ * @param ast the node
+ * @return the value, or nothing if the node is not an int literal
+ */
+std::optional<std::int32_t> CodeGen::int_literal(AST ast) {
+	if (ast.kind() != NodeKind::Int)
+		return std::nullopt;
+	return static_cast<std::int32_t>(std::stoll(std::string(ast.attr())));
+}
+
+/**
+ * Lowers a multiplication by an int literal, on either side, to a shift and at most one add or subtract (-O1)
+ * This covers 0, 1, and powers of two and the numbers next to them, with either sign
+ * @param ast the multiplication
+ * @return whether it was lowered, it is not for other literals or without one
+ */
+bool CodeGen::multiply_by_literal(AST ast) {
+	auto right = int_literal(ast.get_child(1));
+	auto factor = right ? right : int_literal(ast.get_child(0));
+	if (!factor)
+		return false;
+	auto operand = right ? ast.get_child(0) : ast.get_child(1);
+
+	// Wrapping arithmetic is the same on the magnitude, which is negated afterwards for a negative factor
+	auto magnitude = *factor < 0 ? 0u - static_cast<std::uint32_t>(*factor) : static_cast<std::uint32_t>(*factor);
+	auto power = [](std::uint32_t value) { return value != 0 && (value & (value - 1)) == 0; };
+	auto shift = [](std::uint32_t value) {
+		auto bits = 0;
+		while (value > 1) {
+			value >>= 1;
+			bits++;
+		}
+		return bits;
+	};
+	Opcode combine;
+	if (magnitude == 0 || power(magnitude))
+		combine = Opcode::Move;
+	else if (power(magnitude - 1))
+		combine = Opcode::Addu;
+	else if (power(magnitude + 1))
+		combine = Opcode::Subu;
+	else
+		return false;
+
+	gen_pass_1(operand, true);
+	auto reg = alloc_reg();
+	ast.reg() = reg;
+	if (magnitude == 0) {
+		append(Instruction::rn(Opcode::Li, reg, Name::literal("0")));
+		return true;
+	}
+	auto product = *factor < 0 ? alloc_reg() : reg;
+	if (combine == Opcode::Move) {
+		if (magnitude == 1)
+			append(Instruction::rr(Opcode::Move, product, operand.reg()));
+		else
+			append(Instruction::rri(Opcode::Sll, product, operand.reg(), shift(magnitude)));
+	} else {
+		auto shifted = alloc_reg();
+		auto bits = shift(combine == Opcode::Addu ? magnitude - 1 : magnitude + 1);
+		append(Instruction::rri(Opcode::Sll, shifted, operand.reg(), bits));
+		append(Instruction::rrr(combine, product, shifted, operand.reg()));
+	}
+	if (*factor < 0)
+		append(Instruction::rr(Opcode::Negu, reg, product));
+	return true;
+}
+
+/**
+ * Lowers a division or modulo by a nonzero int literal without calling `divmodchk` (-O1)
+ * Powers of two divide by an arithmetic shift, after negative dividends are rounded up to a multiple of the divisor,
+ * and other divisors multiply by a magic reciprocal and keep the high word (Hacker's Delight, section 10-4)
+ * `divmodchk` divides -2147483648 by 1 whatever the divisor, so that dividend is still tested for wherever the
+ * result would otherwise differ
+ * @param ast the division or modulo
+ * @return whether it was lowered, it is not for a divisor that is not a literal, 0 or -2147483648
+ */
+bool CodeGen::divide_by_literal(AST ast) {
+	auto divisor = int_literal(ast.get_child(1));
+	if (!divisor || *divisor == 0 || *divisor == std::numeric_limits<std::int32_t>::min())
+		return false;
+	gen_pass_1(ast.get_child(0), true);
+	auto dividend = ast.get_child(0).reg();
+	auto modulo = ast.kind() == NodeKind::Modulo;
+	auto magnitude = static_cast<std::uint32_t>(*divisor < 0 ? -*divisor : *divisor);
+	auto reg = alloc_reg();
+	ast.reg() = reg;
+
+	// Dividing by -1 negates, which leaves -2147483648 as it is, just like dividing it by 1
+	if (magnitude == 1) {
+		if (modulo)
+			append(Instruction::rn(Opcode::Li, reg, Name::literal("0")));
+		else
+			append(Instruction::rr(*divisor < 0 ? Opcode::Negu : Opcode::Move, reg, dividend));
+		return true;
+	}
+
+	// The remainder of -2147483648 by a power of two is 0 anyway
+	auto power = (magnitude & (magnitude - 1)) == 0;
+	auto bits = 0;
+	while (power && (1u << bits) != magnitude)
+		bits++;
+	auto end = Label(labels++);
+	if (!modulo || !power) {
+		auto smallest = alloc_reg();
+		auto is_smallest = alloc_reg();
+		append(Instruction::rn(Opcode::Li, smallest, Name::literal("-2147483648")));
+		append(Instruction::rrr(Opcode::Seq, is_smallest, dividend, smallest));
+		if (modulo)
+			append(Instruction::rn(Opcode::Li, reg, Name::literal("0")));
+		else
+			append(Instruction::rr(Opcode::Move, reg, dividend));
+		append(Instruction::branch(Opcode::Bnez, is_smallest, end));
+	}
+
+	// The quotient rounded towards zero, of the magnitude of the divisor
+	auto quotient = alloc_reg();
+	if (power) {
+		// Adds magnitude - 1 to negative dividends, the low bits of their sign
+		auto bias = alloc_reg();
+		if (bits == 1) {
+			append(Instruction::rri(Opcode::Srl, bias, dividend, 31));
+		} else {
+			auto sign = alloc_reg();
+			append(Instruction::rri(Opcode::Sra, sign, dividend, 31));
+			append(Instruction::rri(Opcode::Srl, bias, sign, 32 - bits));
+		}
+		auto rounded = alloc_reg();
+		append(Instruction::rrr(Opcode::Addu, rounded, dividend, bias));
+		append(Instruction::rri(Opcode::Sra, quotient, rounded, bits));
+	} else {
+		// The magic number and shift of Hacker's Delight, figure 10-1, for a positive divisor
+		const std::uint32_t two31 = 0x80000000u;
+		auto anc = two31 - 1 - two31 % magnitude;
+		auto p = 31;
+		auto q1 = two31 / anc, r1 = two31 - q1 * anc;
+		auto q2 = two31 / magnitude, r2 = two31 - q2 * magnitude;
+		std::uint32_t delta;
+		do {
+			p++;
+			q1 *= 2;
+			r1 *= 2;
+			if (r1 >= anc) {
+				q1++;
+				r1 -= anc;
+			}
+			q2 *= 2;
+			r2 *= 2;
+			if (r2 >= magnitude) {
+				q2++;
+				r2 -= magnitude;
+			}
+			delta = magnitude - r2;
+		} while (q1 < delta || (q1 == delta && r1 == 0));
+		auto magic = static_cast<std::int32_t>(q2 + 1);
+
+		auto factor = alloc_reg();
+		auto high = alloc_reg();
+		append(Instruction::rri(Opcode::Li, factor, Reg::None, magic));
+		append(Instruction::rrr(Opcode::Mulhi, high, dividend, factor));
+		// A magic number that does not fit as a positive int is a multiple of 2^32 short, which adds the dividend
+		if (magic < 0) {
+			auto corrected = alloc_reg();
+			append(Instruction::rrr(Opcode::Addu, corrected, high, dividend));
+			high = corrected;
+		}
+		auto shifted = alloc_reg();
+		auto negative = alloc_reg();
+		append(Instruction::rri(Opcode::Sra, shifted, high, p - 32));
+		append(Instruction::rri(Opcode::Srl, negative, dividend, 31));
+		append(Instruction::rrr(Opcode::Addu, quotient, shifted, negative));
+	}
+
+	// The remainder takes the sign of the dividend, so only the quotient depends on the sign of the divisor
+	if (modulo) {
+		auto product = alloc_reg();
+		if (power) {
+			append(Instruction::rri(Opcode::Sll, product, quotient, bits));
+		} else {
+			auto factor = alloc_reg();
+			append(Instruction::rri(Opcode::Li, factor, Reg::None, static_cast<int>(magnitude)));
+			append(Instruction::rrr(Opcode::Mul, product, quotient, factor));
+		}
+		append(Instruction::rrr(Opcode::Subu, reg, dividend, product));
+	} else {
+		append(Instruction::rr(*divisor < 0 ? Opcode::Negu : Opcode::Move, reg, quotient));
+	}
+	place(end);
+	return true;
+}
+
+/**
+ * Lowers an else-if chain whose conditions all compare the same variable with an int literal, such as
+ * `if i == 1 {...} else if i == 2 {...}`, so it goes to the arm of the value without testing the arms in turn (-O1)
+ * Values that fill most of the range between the smallest and largest index a jump table, once the value is known to
+ * be in that range, and other values are found by a binary search
+ * The variable is read once, as the conditions are tested before any arm runs and would all read the same value
+ * @param ast the first if of the chain
+ * @return whether the chain was lowered, it is not if it has too few arms or a condition of another form
+ */
+bool CodeGen::dispatch(AST ast) {
+	// Shorter chains test about as fast arm by arm
+	constexpr std::size_t fewest_arms = 4;
+	// A jump table may have up to this many entries for each arm
+	constexpr std::int64_t density = 3;
+
+	// The arms in the order they are written, and the values they are for, where the first arm of a value wins
+	std::vector<AST> arms;
+	std::map<std::int32_t, std::size_t> values;
+	std::optional<AST> otherwise;
+	AST variable;
+	for (auto arm = ast;;) {
+		auto condition = arm.get_child(0);
+		if (condition.kind() != NodeKind::Equal)
+			return false;
+		auto value = int_literal(condition.get_child(1));
+		auto read = condition.get_child(0);
+		if (!value) {
+			value = int_literal(condition.get_child(0));
+			read = condition.get_child(1);
+		}
+		if (!value || read.kind() != NodeKind::Id || read.sym() == nullptr ||
+			(!arms.empty() && read.sym() != variable.sym()))
+			return false;
+		variable = read;
+		if (values.emplace(*value, arms.size()).second)
+			arms.push_back(arm.get_child(1));
+
+		if (arm.children().size() < 3)
+			break;
+		if (arm.get_child(2).kind() == NodeKind::Else) {
+			otherwise = arm.get_child(2).get_child(0);
+			break;
+		}
+		arm = arm.get_child(2);
+	}
+	if (arms.size() < fewest_arms)
+		return false;
+
+	gen_pass_1(variable);
+	auto value = variable.reg();
+	auto end = Label(labels++);
+	Name fallback = otherwise ? Label(labels++) : end;
+	std::vector<Name> entries;
+	for (std::size_t i = 0; i < arms.size(); i++)
+		entries.push_back(Label(labels++));
+
+	auto low = values.begin()->first;
+	auto high = values.rbegin()->first;
+	auto span = static_cast<std::int64_t>(high) - low + 1;
+	if (span <= density * static_cast<std::int64_t>(arms.size())) {
+		// Values below the smallest wrap around to large unsigned offsets, so one comparison checks the range
+		auto offset = value;
+		if (low != 0) {
+			offset = alloc_reg();
+			append(Instruction::rri(Opcode::Subu, offset, value, low));
+		}
+		auto in_range = alloc_reg();
+		append(Instruction::rri(Opcode::Sltu, in_range, offset, static_cast<int>(span)));
+		append(Instruction::branch(Opcode::Beqz, in_range, fallback));
+		auto index = alloc_reg();
+		append(Instruction::rri(Opcode::Sll, index, offset, 2));
+
+		auto &tables = functions.back().tables;
+		JumpTable table{Label(labels++)};
+		for (std::int64_t i = low; i <= high; i++) {
+			auto arm = values.find(static_cast<std::int32_t>(i));
+			table.targets.push_back(arm == values.end() ? fallback : entries[arm->second]);
+		}
+		auto target = alloc_reg();
+		append(Instruction::load(target, {table.label, index}));
+		append(Instruction::rri(Opcode::Jtab, Reg::None, target, static_cast<int>(tables.size())));
+		tables.push_back(std::move(table));
+	} else {
+		std::vector<std::pair<std::int32_t, Name>> sorted;
+		for (auto &[literal, arm]: values)
+			sorted.emplace_back(literal, entries[arm]);
+		search(value, sorted, 0, sorted.size(), fallback);
+	}
+
+	for (std::size_t i = 0; i < arms.size(); i++) {
+		place(entries[i]);
+		gen_pass_1(arms[i]);
+		append(Instruction::jump(Opcode::J, end));
+	}
+	if (otherwise) {
+		place(fallback);
+		gen_pass_1(*otherwise);
+	}
+	place(end);
+	return true;
+}
+
+/**
+ * Jumps to the arm of a value by binary search, the arms in a small enough range are tested one by one (-O1)
+ * @param value the register of the value
+ * @param arms the values of the arms and their labels, in increasing order of value
+ * @param first the first arm of the range
+ * @param last the arm after the last arm of the range
+ * @param otherwise the label to jump to when no arm has the value
+ */
+void CodeGen::search(Reg value, const std::vector<std::pair<std::int32_t, Name>> &arms, std::size_t first,
+					 std::size_t last, Name otherwise) {
+	if (last - first <= 3) {
+		for (auto i = first; i < last; i++) {
+			auto literal = alloc_reg();
+			auto equal = alloc_reg();
+			append(Instruction::rri(Opcode::Li, literal, Reg::None, arms[i].first));
+			append(Instruction::rrr(Opcode::Seq, equal, value, literal));
+			append(Instruction::branch(Opcode::Bnez, equal, arms[i].second));
+		}
+		append(Instruction::jump(Opcode::J, otherwise));
+		return;
+	}
+	auto middle = first + (last - first) / 2;
+	auto below = Label(labels++);
+	auto literal = alloc_reg();
+	auto less = alloc_reg();
+	append(Instruction::rri(Opcode::Li, literal, Reg::None, arms[middle].first));
+	append(Instruction::rrr(Opcode::Slt, less, value, literal));
+	append(Instruction::branch(Opcode::Bnez, less, below));
+	search(value, arms, middle, last, otherwise);
+	place(below);
+	search(value, arms, first, middle, otherwise);
+}
+
+/**
+ * Gets the instruction that computes a binary operator
+ * @param kind the kind of the binary operator
+ * @return the opcode of the instruction
+ */
+Opcode CodeGen::binary_opcode(NodeKind kind) {
+	switch (kind) {
+		case NodeKind::Equal: return Opcode::Seq;
+		case NodeKind::NotEqual: return Opcode::Sne;
+		case NodeKind::GreaterEqual: return Opcode::Sge;
+		case NodeKind::Greater: return Opcode::Sgt;
+		case NodeKind::LessEqual: return Opcode::Sle;
+		case NodeKind::Less: return Opcode::Slt;
+		case NodeKind::Multiply: return Opcode::Mul;
+		case NodeKind::Divide: return Opcode::Div;
+		case NodeKind::Modulo: return Opcode::Rem;
+		case NodeKind::Add: return Opcode::Addu;
+		case NodeKind::Subtract: return Opcode::Subu;
+		default: return Opcode::Move;
+	}
+}
+
+int CodeGen::count_locals(AST ast) {
+	int count = 0;
+	switch (ast.kind()) {
+		case NodeKind::Var: {
+			count++;
+			break;
+		}
+		case NodeKind::Block: {
+			for (auto child: ast.children()) {
+				count += count_locals(child);
+			}
+			break;
+		}
+		case NodeKind::If: {
+			count += count_locals(ast.get_child(1));
+			if (ast.children().size() == 3) {
+				count += count_locals(ast.get_child(2).get_child(0));
+			}
+			break;
+		}
+		case NodeKind::For: {
+			count += count_locals(ast.get_child(1));
+			break;
+		}
+		default:
+			break;
+	}
+	return count;
+}
+
+/**
+ * Lowers a call by lowering the body of the called function in its place (-O1)
+ * The formals and locals of the expansion get registers of their own, so it cannot disturb the caller or another
+ * expansion of the same function, and its returns jump past it with the result in the register of the call
+ * @param call the call
+ * @param func the called function, which cannot call itself
+ */
+void CodeGen::expand_call(AST call, AST func) {
+	// The actuals are all lowered before any formal is bound, since an actual may expand the same function
+	for (auto actual: call.get_child(1).children())
+		gen_pass_1(actual, true);
+	auto formal = func.get_child(1).get_child(0).children().begin();
+	for (auto actual: call.get_child(1).children()) {
+		auto reg = alloc_reg();
+		append(Instruction::rr(Opcode::Move, reg, actual.reg()));
+		promoted[(*formal).get_child(0).sym()] = reg;
+		++formal;
+	}
+
+	auto end = Label(labels++);
+	auto result = alloc_reg();
+	call.reg() = result;
+	expansions.push_back({end, result});
+	gen_pass_1(func.get_child(2));
+	check_return(func);
+	expansions.pop_back();
+	place(end);
+}
+
+/**
+ * Ends a function that must return a value with a jump to `error`, for when it runs off its end
+ * The message is made once per function, and shared by the expansions of the function
+ * @param func the function
+ */
+void CodeGen::check_return(AST func) {
+	if(func.get_child(1).get_child(1).attr() == "$void")
+		return;
+	auto error_string = "error: function \'" + std::string(func.get_child(0).attr()) + "\' must return a value\n";
+	if (!string_to_global.count(error_string)) {
+		auto error_string_global = StrGlobal(str_globals++);
+		string_to_global[error_string] = error_string_global;
+		global_to_string[error_string_global.to_string()] = error_string;
+	}
+	append(Instruction::rn(Opcode::La, Reg::A0, string_to_global[error_string]));
+	append(Instruction::jump(Opcode::J, Name::function("error")));
+}
+
+/**
+ * Finds the functions that can run, following calls and tail jumps from `main`, and from `halt`, which `_start`
+ * jumps to once `main` returns
+ * Predefined functions only ever jump to `halt`, so their own calls need not be followed
+ */
+void CodeGen::find_reachable() {
+	std::map<std::string_view, const Function*> defined;
+	for (auto &function: functions)
+		defined[function.name] = &function;
+
+	std::vector<std::string_view> pending = {"main", "halt"};
+	while (!pending.empty()) {
+		auto name = pending.back();
+		pending.pop_back();
+		if (!reachable.insert(name).second || !defined.count(name))
+			continue;
+		for (auto &block: defined[name]->blocks) {
+			for (auto &instruction: block.instructions) {
+				if ((instruction.op == Opcode::Jal || instruction.op == Opcode::J) && instruction.name.kind == NameKind::Function)
+					pending.push_back(instruction.name.text);
+			}
+		}
+	}
+}
+
+/**
+ * Forgets the string globals that no reachable function loads, such as the return errors of functions that are
+ * left out, so they are not written
+ * The empty string is always kept, as uninitialized global strings point at it
+ */
+void CodeGen::drop_unused_strings() {
+	std::set<std::string> used = {StrGlobal(0).to_string()};
+	for (auto &function: functions) {
+		if (!reachable.count(function.name))
+			continue;
+		for (auto &block: function.blocks) {
+			for (auto &instruction: block.instructions) {
+				if (instruction.op == Opcode::La && instruction.name.kind == NameKind::String)
+					used.insert(instruction.name.to_string());
+			}
+		}
+	}
+	for (auto it = global_to_string.begin(); it != global_to_string.end();) {
+		if (used.count(it->first))
+			it++;
+		else
+			it = global_to_string.erase(it);
+	}
+}
+
+/**
+ * Gets whether a predefined function is left out, because the program defines its own or (-O1) never calls it
+ * @param name the name of the predefined function
+ * @return whether the function is left out
+ */
+bool CodeGen::omitted(const std::string &name) {
+	return redefined[name] || (options.level >= 1 && !reachable.count(name));
+}
+
+void CodeGen::gen_pass_2() {
+	std::map<char, char> escapes = {
+		{'b' , '\b'},
+		{'t' , '\t' },
+		{'n' , '\n' },
+		{'f' , '\f' },
+		{'r' , '\r' },
+		{'"' , '"' },
+		{'\'', '\'' },
+		{'\\' , '\\' },
+	};
+
+	if (global_to_string.empty()) {
+		return;
+	}
+
+	// Sort strings by length
+	std::vector<std::pair<std::string, std::string>> sorted;
+	for (auto it = global_to_string.begin(); it != global_to_string.end(); it++) {
+		sorted.push_back(*it);
+	}
+	std::sort(sorted.begin(), sorted.end(), [](std::pair<std::string, std::string>& a, std::pair<std::string, std::string>& b)
+	{
+		if (a.second.length() == b.second.length()) { // If length is the same
+			int cmp = a.second.compare(b.second); // Compare alphabetically
+			if (cmp == 0) { // If they are the same alphabetically
+				// Compare case-insensitively
+				return std::lexicographical_compare(a.second.begin(), a.second.end(), b.second.begin(), b.second.end(),
+													[](char a, char b) { return std::tolower(a) < std::tolower(b); });
+			} else {
+				return cmp < 0;
+			}
+		} else {
+			return a.second.length() < b.second.length();
+		}
+	});
+
+	emit("    .data");
+	auto escaping = false;
+	for (auto &[label, value]: sorted) {
+		emit(label, ":");
+		for (char &c: value) {
+			if(c == 92 && !escaping) {
+				escaping = true;
+			} else if(escaping && escapes.count(c)) {
+				emit("    .byte ", int(escapes[c]));
+				escaping = false;
+			} else {
+				emit("    .byte ", int(c));
+			}
+		}
+		emit("    .byte 0");
+	}
+	emit("    .align 2");
+	emit("    .text");
+}
+
+/**
+ * Generates the assembly for an annotated tree
+ * The assembly is buffered, and written out once it is complete
+ * @param root the annotated abstract syntax tree
+ */
+void CodeGen::generate(AST root) {
+	emit("    Ltrue = 1");
+	emit("    Lfalse = 0");
+	emit("    .text");
+	emit("    .globl _start");
+	emit("_start:");
+	emit("    jal main");
+	emit("    j halt");
+
+	// Populate the globals
+	gen_pass_0(root);
+
+	// Majority of the code generation
+	if (options.level >= 1)
+		inlined = Inliner(root, options.inline_limit).inlined();
+	gen_pass_1(root);
+	if (options.level >= 1) {
+		auto clobbers = predefined_clobbers();
+		for (auto &function: functions) {
+			allocate_registers(function, clobbers);
+			build_frame(function);
+			peephole(function);
+		}
+		find_reachable();
+		drop_unused_strings();
+	}
+	for (auto &function: functions) {
+		if (options.level == 0 || reachable.count(function.name))
+			print(function, writer);
+	}
+
+	// Populate predefined functions
+	get_char();
+	prints();
+	printi();
+	halt();
+	printb();
+	printc();
+	len();
+	divmodchk();
+	error();
+
+	// String tomfoolery
+	gen_pass_2();
+
+	// Write out the buffered assembly
+	writer.flush();
+}
+
+/**
+ * Gets the registers that calls to the predefined functions overwrite, as they are written below at -O1
+ * Functions the program redefines may overwrite any register, so they are left out
+ * @return the registers each predefined function overwrites, by name
+ */
+std::unordered_map<std::string_view, RegSet> CodeGen::predefined_clobbers() {
+	auto set = [](std::initializer_list<Reg> regs) {
+		RegSet set;
+		set.set(static_cast<std::size_t>(Reg::Ra));
+		for (auto reg: regs)
+			set.set(static_cast<std::size_t>(reg));
+		return set;
+	};
+	std::unordered_map<std::string_view, RegSet> clobbers = {
+			{"getchar", set({Reg::V0, Reg::V1, argument(0), argument(1)})},
+			{"halt", set({Reg::V0})},
+			{"len", set({Reg::V0, Reg::V1})},
+			{"printb", set({Reg::V0, argument(0)})},
+			{"printc", set({Reg::V0})},
+			{"printi", set({Reg::V0})},
+			{"prints", set({Reg::V0})},
+			{"divmodchk", set({Reg::V0, argument(0), argument(1)})},
+			{"error", set({Reg::V0})},
+	};
+	for (auto &[name, is_redefined]: redefined) {
+		if (is_redefined)
+			clobbers.erase(name);
+	}
+	return clobbers;
+}
+
+void CodeGen::get_char(){
+	if(omitted("getchar"))
+		return;
+
+	emit("    .data");
+	emit("    char: .space 2");
+	emit("    .text");
+	emit("getchar:");
+	if (options.level >= 1) {
+		// Compares with $v1 instead of $s0, so nothing is saved on the stack
+		emit("    li $v0,8");
+		emit("    la $a0,char");
+		emit("    la $a1,2");
+		emit("    syscall");
+		emit("    lb $v0,char");
+		emit("    li $v1,4");
+		emit("    beq $v0,$v1,getchar_eof");
+		emit("    beqz $v0,getchar_eof");
+		emit("    jr $ra");
+		emit("getchar_eof:");
+		emit("    li $v0,-1");
+		emit("    jr $ra");
+		return;
+	}
+	emit("    addi $sp,$sp,-4");
+	emit("    sw $s0,0($sp)");
+	emit("    li $v0,8");
+	emit("    la $a0,char");
+	emit("    la $a1,2");
+	emit("    syscall");
+	emit("    lb $v0,char");
+	emit("    li $s0,4");
+	emit("    beq $v0,$s0,getchar_eof");
+	emit("    li $s0,0");
+	emit("    beq $v0,$s0,getchar_eof");
+	emit("getchar_epilogue:");
+	emit("    lw $s0,0($sp)");
+	emit("    addi $sp,$sp,4");
+	emit("    jr $ra ");
+	emit("getchar_eof:");
+	emit("    li $v0,-1");
+	emit("    j getchar_epilogue");
+}
+
+void CodeGen::prints(){
+	if(omitted("prints"))
+		return;
+
+	emit("prints:");
+	emit("    li $v0,4");
+	emit("    syscall");
+	emit("    jr $ra ");
+}
+
+void CodeGen::printi(){
+	if(omitted("printi"))
+		return;
+
+	emit("printi:");
+	emit("    li $v0,1");
+	emit("    syscall");
+	emit("    jr $ra ");
+
+}
+
+void CodeGen::halt(){
+	if(omitted("halt"))
+		return;
+
+	emit("halt:");
+	emit("    li $v0,10");
+	emit("    syscall");
+	emit("    jr $ra ");
+
+}
+
+void CodeGen::printb(){
+	if(omitted("printb"))
+		return;
+
+	auto t = StrGlobal(str_globals++);
+	auto f = StrGlobal(str_globals++);
+
+	string_to_global["true"] = t;
+	global_to_string[t.to_string()] = "true";
+	string_to_global["false"] = f;
+	global_to_string[f.to_string()] = "false";
+
+	emit("printb:");
+	if (options.level == 0)
+		emit("	  li $t0,1");
+	emit("	  beq $a0,$zero,printb_false");
+	emit("	  la $a0,", t);
+	emit("	  j printb_epilogue");
+	emit("printb_false:");
+	emit("	  la $a0,", f);
+	emit("printb_epilogue:");
+	emit("	  li $v0,4");
+	emit("	  syscall");
+	emit("	  jr $ra");
+}
+
+void CodeGen::printc(){
+	if(omitted("printc"))
+		return;
+
+	emit("printc:");
+	emit("    li $v0,11");
+	emit("    syscall");
+	emit("    jr $ra ");
+}
+
+void CodeGen::len(){
+	if(omitted("len"))
+		return;
+
+	emit("len:");
+	if (options.level >= 1) {
+		// Counts with $v0 and $v1 only, leaving the argument and the stack alone
+		emit("    move $v0,$a0");
+		emit("len_loop:");
+		emit("    lb $v1,0($v0)");
+		emit("    beqz $v1,len_epilogue");
+		emit("    addi $v0,$v0,1");
+		emit("    j len_loop");
+		emit("len_epilogue:");
+		emit("    subu $v0,$v0,$a0");
+		emit("    jr $ra");
+		return;
+	}
+	emit("    subu $sp,$sp,8");
+	emit("    sw $ra,0($sp)");
+	emit("    sw $a0,4($sp)");
+	emit("    li $t0,0");
+	emit("len_loop:");
+	emit("    lb $t1,0($a0)");
+	emit("    beqz $t1,len_epilogue");
+	emit("    addi $a0,$a0,1");
+	emit("    addi $t0,$t0,1");
+	emit("    j len_loop");
+	emit("len_epilogue:");
+	emit("    move $v0,$t0");
+	emit("    lw $ra,0($sp)");
+	emit("    addu $sp,$sp,8");
+	emit("    jr $ra ");
+}
+
+void CodeGen::divmodchk(){
+	if(omitted("divmodchk"))
+		return;
+
+	auto err = StrGlobal(str_globals++);
+	global_to_string[err.to_string()] = "error: division by zero\n";
+
+	emit("divmodchk:");
+	if (options.level == 0) {
+		emit("    subu $sp,$sp,12");
+		emit("    sw $ra,0($sp)");
+		emit("    sw $a0,4($sp)");
+		emit("    sw $a1,8($sp)");
+	}
+	emit("    bne $a1,$zero,divmodchk_min");
+	emit("    la $a0,", err);
+	emit("    li $v0,4");
+	emit("    syscall");
+	emit("    j halt");
+	emit("divmodchk_min:");
+	emit("    bne $a0,-2147483648,divmodchk_epilogue");
+	emit("    li $a1,1");
+	emit("divmodchk_epilogue:");
+	emit("    move $v0,$a1");
+	if (options.level == 0) {
+		emit("    lw $ra,0($sp)");
+		emit("    addu $sp,$sp,12");
+	}
+	emit("    jr $ra ");
+}
+
+void CodeGen::error(){
+	if(omitted("error"))
+		return;
+
+	emit("error:");
+	emit("    li $v0,4");
+	emit("    syscall");
+	emit("    j halt");
+}
+
+/**
+ * Generates the assembly for an annotated tree, writing it to standard output
+ * @param root the annotated abstract syntax tree
+ */
+void generate_code(AST root) {
+	CodeGen(std::cout).generate(root);
+}
@@ -1,66 +1,149 @@
-#pragma once
-
-#include <string>
-#include <map>
-
-#include "ast.h"
-
-class Label {
-private:
-	static int counter;
-	int value;
-public:
-	Label() {
-		value = counter++;
-	}
-
-	std::string to_string() {
-		return "L" + std::to_string(value);
-	}
-};
-
-class Global {
-private:
-	static int counter;
-	int value;
-public:
-	Global() {
-		value = counter++;
-	}
-
-	std::string to_string() {
-		return "G" + std::to_string(value);
-	}
-};
-
-class StrGlobal {
-private:
-	static int counter;
-	int value;
-public:
-	StrGlobal() {
-		value = counter++;
-	}
-
-	std::string to_string() {
-		return "S" + std::to_string(value);
-	}
-};
-
-void emit(std::string line);
-void gen_pass_0(AST *ast);
-void gen_pass_1(AST *ast, bool in_call);
-void gen_pass_2();
-int count_locals(AST *ast);
-void generate_code(AST *root);
-
-// Predefined functions
-void get_char();
-void prints();
-void printi();
-void halt();
-void printb();
-void printc();
-void len();
-void divmodchk();
-void error();
\ No newline at end of file
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <map>
+#include <optional>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include "ast.h"
+#include "asm_writer.h"
+#include "mir.h"
+
+class Label : public Name {
+public:
+	explicit Label(int value) : Name{NameKind::Label, value} {}
+};
+
+class Global : public Name {
+public:
+	explicit Global(int value) : Name{NameKind::Global, value} {}
+};
+
+class StrGlobal : public Name {
+public:
+	explicit StrGlobal(int value) : Name{NameKind::String, value} {}
+};
+
+/**
+ * Options that change the generated code but not what it does
+ */
+struct CodeGenOptions {
+	// The optimization level, 0 prints functions as they were lowered and 1 allocates registers by linear scan,
+	// runs the peephole optimizer and leaves out the functions and strings that are never used
+	int level = 0;
+	// The largest function, in nodes of its body, whose calls are expanded in place at -O1 (see `Inliner`),
+	// 0 expands none
+	int inline_limit = 30;
+};
+
+/**
+ * Generates MIPS assembly for one annotated tree
+ * Functions are lowered to instructions (see `mir.h`) and printed once they are complete,
+ * while globals, strings and the predefined functions are written as text
+ * All of the state of a compilation lives in the instance, so separate instances can run on separate threads
+ */
+class CodeGen {
+public:
+	explicit CodeGen(std::ostream &out, CodeGenOptions options = {});
+	void generate(AST root);
+
+private:
+	AsmWriter writer;
+	CodeGenOptions options;
+
+	// Counters for the names of labels, globals and string globals
+	int labels = 0;
+	int globals = 0;
+	int str_globals = 0;
+
+	std::vector<Function> functions;
+
+	std::vector<Name> break_stack;
+	std::string_view current_func;
+	int current_offset = 0;
+
+	std::map<void*, Address> vars;
+	// The registers of the locals and formals, which are kept in registers rather than stack slots (-O1)
+	std::map<void*, Reg> promoted;
+
+	std::map<std::string, std::string> global_to_string;
+	std::map<std::string, Name> string_to_global;
+
+	// The number of virtual registers of the current function (-O1)
+	int virtual_registers = 0;
+
+	// The free registers of the current function, made on first use
+	std::optional<std::vector<Reg>> available;
+	std::vector<Reg> used_registers;
+
+	// The functions that can run, user defined or predefined (-O1)
+	std::set<std::string_view> reachable;
+
+	/**
+	 * A call that is being expanded in place, where its returns go (-O1)
+	 */
+	struct Expansion {
+		Name end;
+		Reg result;
+	};
+
+	// The functions whose calls are expanded in place, and the calls being expanded, innermost last (-O1)
+	std::unordered_map<std::string_view, AST> inlined;
+	std::vector<Expansion> expansions;
+
+	std::map<std::string, bool> redefined = {
+			{"getchar", false},
+			{"halt", false},
+			{"len", false},
+			{"printb", false},
+			{"printc", false},
+			{"printi", false},
+			{"prints", false},
+			{"divmodchk", false},
+			{"error", false},
+	};
+
+	void populate_registers();
+	Reg alloc_reg();
+	void freereg(Reg reg);
+	void append(const Instruction &instruction);
+	void place(Name label);
+	static Opcode binary_opcode(NodeKind kind);
+	static std::optional<std::int32_t> int_literal(AST ast);
+	bool multiply_by_literal(AST ast);
+	bool divide_by_literal(AST ast);
+	bool dispatch(AST ast);
+	void search(Reg value, const std::vector<std::pair<std::int32_t, Name>> &arms, std::size_t first, std::size_t last,
+				Name otherwise);
+	template<typename... Pieces>
+	void emit(const Pieces &... pieces) {
+		writer.line(pieces...);
+	}
+	void gen_pass_0(AST ast);
+	void gen_pass_1(AST ast, bool in_call = false);
+	void gen_pass_2();
+	void expand_call(AST call, AST func);
+	void check_return(AST func);
+	static int count_locals(AST ast);
+	void find_reachable();
+	void drop_unused_strings();
+	bool omitted(const std::string &name);
+	std::unordered_map<std::string_view, RegSet> predefined_clobbers();
+
+	// Predefined functions
+	void get_char();
+	void prints();
+	void printi();
+	void halt();
+	void printb();
+	void printc();
+	void len();
+	void divmodchk();
+	void error();
+};
+
+void generate_code(AST root);
@@ -0,0 +1,284 @@
+#include <limits>
+#include <string>
+
+#include "constant_folder.h"
+#include "symbol_table.h"
+#include "universe.h"
+
+namespace {
+
+// Stands in for the block of a node that is not directly in a block
+constexpr NodeId no_block = UINT32_MAX;
+
+}
+
+/**
+ * ConstantFolder class constructor
+ * @param root the annotated abstract syntax tree, which is folded in place
+ */
+ConstantFolder::ConstantFolder(AST root) : root(root), tree(*root.tree) {}
+
+/**
+ * Folds every function of the tree
+ * Folded nodes become literals, the code generator cannot tell them apart from literals in the source
+ */
+void ConstantFolder::fold() {
+    for (auto func: root.children()) {
+        if (func.kind() != NodeKind::Func)
+            continue;
+        locals.clear();
+        known.clear();
+        auto body = func.get_child(2);
+        count_assignments(body);
+        statement(body);
+    }
+}
+
+/**
+ * Counts the assignments to each local of a function
+ * Each node settles the statements among its children, so the walk needs no stack of enclosing blocks
+ * @param body the body of the function
+ */
+void ConstantFolder::count_assignments(AST body) {
+    body.pre([&](AST ast) {
+        auto block = ast.kind() == NodeKind::Block ? ast.id : no_block;
+        for (auto child: ast.children()) {
+            if (child.kind() == NodeKind::Var) {
+                locals[child.sym()].block = block;
+            } else if (child.kind() == NodeKind::Assign) {
+                auto local = locals.find(child.get_child(0).sym());
+                if (local == locals.end())
+                    continue;
+                auto &assignments = local->second;
+                assignments.count++;
+                assignments.in_block = assignments.count == 1 && block == assignments.block;
+            }
+        }
+    });
+}
+
+/**
+ * Folds a statement, following the order statements run in
+ * A local holds its zero value from its declaration until its assignment, and the assigned constant after it
+ * @param ast the statement
+ */
+void ConstantFolder::statement(AST ast) {
+    switch (ast.kind()) {
+        case NodeKind::Block:
+            for (auto child: ast.children())
+                statement(child);
+            break;
+        case NodeKind::Var: {
+            auto &assignments = locals[ast.sym()];
+            if (assignments.count == 0 || assignments.in_block)
+                known[ast.sym()] = {ast.sym()->sig->kind};
+            break;
+        }
+        case NodeKind::Assign: {
+            expression(ast.get_child(1));
+            auto target = ast.get_child(0).sym();
+            auto local = locals.find(target);
+            if (local == locals.end() || !local->second.in_block)
+                break;
+            if (auto value = constant(ast.get_child(1)))
+                known[target] = *value;
+            else
+                known.erase(target);
+            break;
+        }
+        case NodeKind::If:
+            expression(ast.get_child(0));
+            statement(ast.get_child(1));
+            if (ast.children().size() == 3)
+                statement(ast.get_child(2));
+            break;
+        case NodeKind::Else:
+            statement(ast.get_child(0));
+            break;
+        case NodeKind::For:
+            expression(ast.get_child(0));
+            statement(ast.get_child(1));
+            break;
+        case NodeKind::Return:
+            if (!ast.children().empty())
+                expression(ast.get_child(0));
+            break;
+        case NodeKind::Break:
+        case NodeKind::EmptyStmt:
+            break;
+        default:
+            expression(ast);
+            break;
+    }
+}
+
+/**
+ * Folds an expression, its operands first
+ * @param ast the expression
+ */
+void ConstantFolder::expression(AST ast) {
+    switch (ast.kind()) {
+        case NodeKind::Int:
+        case NodeKind::String:
+            return;
+        case NodeKind::Id: {
+            auto value = known.find(ast.sym());
+            if (value != known.end())
+                replace(ast, value->second);
+            return;
+        }
+        case NodeKind::FuncCall: {
+            auto actuals = ast.get_child(1);
+            for (auto actual: actuals.children())
+                expression(actual);
+            if (ast.get_child(0).sym() != SymbolTable::predeclared(universe_id("len")) || actuals.children().size() != 1)
+                return;
+            auto value = constant(actuals.get_child(0));
+            if (value && value->kind == TypeKind::Str)
+                replace(ast, {TypeKind::Int, length(value->text)});
+            return;
+        }
+        case NodeKind::And:
+        case NodeKind::Or: {
+            // The right operand is only evaluated when the left one does not decide the result
+            expression(ast.get_child(0));
+            auto left = constant(ast.get_child(0));
+            if (left && (left->value != 0) == (ast.kind() == NodeKind::Or)) {
+                replace(ast, *left);
+                return;
+            }
+            expression(ast.get_child(1));
+            if (left)
+                tree.replace(ast, ast.get_child(1));
+            return;
+        }
+        case NodeKind::Not:
+        case NodeKind::Negate: {
+            expression(ast.get_child(0));
+            auto operand = constant(ast.get_child(0));
+            if (!operand)
+                return;
+            if (ast.kind() == NodeKind::Not)
+                replace(ast, {TypeKind::Bool, !operand->value});
+            else
+                replace(ast, {TypeKind::Int, static_cast<std::int32_t>(0u - static_cast<std::uint32_t>(operand->value))});
+            return;
+        }
+        case NodeKind::Equal:
+        case NodeKind::NotEqual:
+        case NodeKind::Less:
+        case NodeKind::LessEqual:
+        case NodeKind::Greater:
+        case NodeKind::GreaterEqual:
+        case NodeKind::Add:
+        case NodeKind::Subtract:
+        case NodeKind::Multiply:
+        case NodeKind::Divide:
+        case NodeKind::Modulo: {
+            expression(ast.get_child(0));
+            expression(ast.get_child(1));
+            auto left = constant(ast.get_child(0));
+            auto right = constant(ast.get_child(1));
+            // Strings compare by address, which is not known until the strings are laid out
+            if (!left || !right || left->kind != right->kind || left->kind == TypeKind::Str)
+                return;
+            if (auto value = evaluate(ast.kind(), left->value, right->value))
+                replace(ast, {ast.sig()->kind, *value});
+            return;
+        }
+        default:
+            for (auto child: ast.children())
+                expression(child);
+            return;
+    }
+}
+
+/**
+ * Gets the value of a literal
+ * @param ast the node
+ * @return the value, or nothing if the node is not an int, string, true or false literal
+ */
+std::optional<ConstantFolder::Constant> ConstantFolder::constant(AST ast) const {
+    switch (ast.kind()) {
+        case NodeKind::Int:
+            return Constant{TypeKind::Int, static_cast<std::int32_t>(std::stoll(std::string(ast.attr())))};
+        case NodeKind::String:
+            return Constant{TypeKind::Str, 0, ast.attr()};
+        case NodeKind::Id:
+            // Only the universe's true and false are constants, the names can be redeclared
+            if (ast.sym() != nullptr && ast.sym()->is_const)
+                return Constant{TypeKind::Bool, ast.symbol() != universe_id("false")};
+            return std::nullopt;
+        default:
+            return std::nullopt;
+    }
+}
+
+/**
+ * Turns a node into the literal of a constant
+ * @param ast the node
+ * @param constant the value of the node
+ */
+void ConstantFolder::replace(AST ast, const Constant &constant) {
+    switch (constant.kind) {
+        case TypeKind::Int:
+            tree.replace(ast, NodeKind::Int, tree.intern(std::to_string(constant.value)));
+            break;
+        case TypeKind::Bool: {
+            auto symbol = universe_id(constant.value ? "true" : "false");
+            tree.replace(ast, NodeKind::Id, universal_records[symbol].name, symbol);
+            ast.sym() = SymbolTable::predeclared(symbol);
+            break;
+        }
+        default:
+            tree.replace(ast, NodeKind::String, constant.text);
+            break;
+    }
+    ast.sig() = Type::basic(constant.kind);
+}
+
+/**
+ * Evaluates a binary operator on ints, or on bools as 0 and 1, the way the generated code does
+ * Arithmetic wraps around, and a dividend of -2147483648 is divided by 1, as the runtime check does
+ * @param kind the operator
+ * @param left the left operand
+ * @param right the right operand
+ * @return the result, or nothing for division by zero, which must fail at runtime
+ */
+std::optional<std::int32_t> ConstantFolder::evaluate(NodeKind kind, std::int32_t left, std::int32_t right) {
+    auto wrap = [](std::uint32_t value) { return static_cast<std::int32_t>(value); };
+    auto l = static_cast<std::uint32_t>(left), r = static_cast<std::uint32_t>(right);
+    switch (kind) {
+        case NodeKind::Equal: return left == right;
+        case NodeKind::NotEqual: return left != right;
+        case NodeKind::Less: return left < right;
+        case NodeKind::LessEqual: return left <= right;
+        case NodeKind::Greater: return left > right;
+        case NodeKind::GreaterEqual: return left >= right;
+        case NodeKind::Add: return wrap(l + r);
+        case NodeKind::Subtract: return wrap(l - r);
+        case NodeKind::Multiply: return wrap(l * r);
+        case NodeKind::Divide:
+        case NodeKind::Modulo:
+            if (right == 0)
+                return std::nullopt;
+            if (left == std::numeric_limits<std::int32_t>::min())
+                right = 1;
+            return kind == NodeKind::Divide ? left / right : left % right;
+        default:
+            return std::nullopt;
+    }
+}
+
+/**
+ * Gets the length of a string literal as the generated code counts it, an escape sequence is one byte
+ * @param text the string as written in the source, without quotes
+ * @return the number of bytes of the string
+ */
+std::int32_t ConstantFolder::length(std::string_view text) {
+    std::int32_t length = 0;
+    for (std::size_t i = 0; i < text.size(); i++, length++)
+        if (text[i] == '\\' && i + 1 < text.size())
+            i++;
+    return length;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+
+#include "ast.h"
+#include "record.h"
+
+/**
+ * Folds the constant expressions of an annotated tree into literals (-O1)
+ * Integer arithmetic wraps around at 32 bits, and division by a constant zero is left for the runtime check
+ * Locals that are assigned a constant once, in the block that declares them, are replaced by that constant
+ */
+class ConstantFolder {
+public:
+    explicit ConstantFolder(AST root);
+    void fold();
+
+private:
+    /**
+     * The value of a literal, `value` holds ints and bools and `text` holds strings
+     */
+    struct Constant {
+        TypeKind kind;
+        std::int32_t value = 0;
+        std::string_view text;
+    };
+
+    /**
+     * How a local is assigned within its function
+     */
+    struct Assignments {
+        NodeId block;
+        int count = 0;
+        // Whether the only assignment is a statement of the block that declares the local
+        bool in_block = false;
+    };
+
+    AST root;
+    Tree &tree;
+    std::unordered_map<const Record *, Assignments> locals;
+    std::unordered_map<const Record *, Constant> known;
+
+    void count_assignments(AST body);
+    void statement(AST ast);
+    void expression(AST ast);
+    std::optional<Constant> constant(AST ast) const;
+    void replace(AST ast, const Constant &constant);
+    static std::optional<std::int32_t> evaluate(NodeKind kind, std::int32_t left, std::int32_t right);
+    static std::int32_t length(std::string_view text);
+};
@@ -1,6 +1,9 @@
 #include <iostream>
 #include <filesystem>
-#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "file_input.h"
 
 /**
@@ -11,20 +14,47 @@ FileInput::FileInput(const std::string &filename) : Input(filename) {
 
 }
 
+/**
+ * Unmaps the file, invalidating any views into it
+ */
+FileInput::~FileInput() {
+    if (mapping != nullptr)
+        munmap(mapping, mapping_length);
+}
+
 /**
  * Reads the entire contents of the file
- * @return the entire contents of the file as a string
+ * Regular files are mapped read-only and used in place, anything else (pipes, devices) is read into a buffer
  */
 void FileInput::read() {
-    std::ifstream filestream(Input::name);
+    int fd = open(Input::name.c_str(), O_RDONLY);
 
     // Verify the file exists
     // TODO: Maybe throw error instead
-    if (!filestream.is_open()){
+    if (fd < 0) {
         std::cerr << "File " + Input::name + " not found: " << std::filesystem::current_path() << std::endl;
         exit(EXIT_FAILURE);
     }
 
-    Input::data = std::string((std::istreambuf_iterator<char>(filestream)),std::istreambuf_iterator<char>());
-    filestream.close();
+    struct stat status {};
+    if (fstat(fd, &status) == 0 && S_ISREG(status.st_mode) && status.st_size > 0) {
+        mapping_length = status.st_size;
+        mapping = mmap(nullptr, mapping_length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            mapping = nullptr;
+        } else {
+            madvise(mapping, mapping_length, MADV_SEQUENTIAL);
+            Input::data = std::string_view(static_cast<const char *>(mapping), mapping_length);
+            close(fd);
+            return;
+        }
+    }
+
+    // Fall back to reading the file
+    char chunk[1 << 16];
+    ssize_t count;
+    while ((count = ::read(fd, chunk, sizeof(chunk))) > 0)
+        buffer.append(chunk, count);
+    Input::data = buffer;
+    close(fd);
 }
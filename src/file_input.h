@@ -6,5 +6,11 @@
 class FileInput : public Input {
 public:
     FileInput(const std::string &filename);
+    ~FileInput() override;
     void read() override;
+
+private:
+    void *mapping = nullptr;
+    size_t mapping_length = 0;
+    std::string buffer;
 };
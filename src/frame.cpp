@@ -0,0 +1,265 @@
+#include <algorithm>
+#include <vector>
+
+#include "frame.h"
+
+namespace {
+
+// The registers that values in callee-saved registers can be moved to on the paths without a frame
+constexpr Reg scratch[] = {
+        Reg::T0, Reg::T1, Reg::T2, Reg::T3, Reg::T4, Reg::T5, Reg::T6, Reg::T7, Reg::T8, Reg::T9,
+};
+
+/**
+ * Decides which blocks of a function run with its stack frame, and adds the instructions that make and remove it
+ * A block needs the frame if it calls a function, which overwrites $ra, or reads or writes a stack slot
+ * The blocks that follow a block with the frame have it as well, up to the epilogue, and a block that is entered
+ * both with and without the frame makes the frame in the blocks before it instead
+ * The frame is made at the start of the blocks that have it but are entered without it, and removed before the
+ * epilogue on every path that has it
+ */
+class Frame {
+public:
+    explicit Frame(Function &function);
+    void build();
+
+private:
+    Function &function;
+    Graph graph;
+    std::vector<std::vector<std::size_t>> predecessors;
+    std::size_t epilogue = Graph::none;
+    std::vector<bool> needed;
+    std::vector<bool> framed;
+
+    void spread();
+    bool references(std::size_t block, Reg reg) const;
+    bool move_saved_registers(std::vector<std::pair<Reg, Reg>> &moved);
+    void remove_before_epilogue(const std::vector<Instruction> &removal);
+};
+
+Frame::Frame(Function &function) : function(function), graph(function) {
+    auto &blocks = function.blocks;
+    predecessors.resize(blocks.size());
+    needed.resize(blocks.size());
+    for (std::size_t i = 0; i < blocks.size(); i++) {
+        if (blocks[i].label.kind == NameKind::Epilogue)
+            epilogue = i;
+        for (auto successor: graph.successors(i))
+            if (successor != Graph::none)
+                predecessors[successor].push_back(i);
+        for (auto &instruction: blocks[i].instructions) {
+            auto slot = (instruction.op == Opcode::Lw || instruction.op == Opcode::Sw) && instruction.rs == Reg::Sp;
+            if (instruction.op == Opcode::Jal || slot)
+                needed[i] = true;
+        }
+    }
+}
+
+/**
+ * Gives the frame to the blocks that need it, to the blocks after them, and to the blocks before a block that is
+ * entered both with and without it
+ */
+void Frame::spread() {
+    framed = needed;
+    auto changed = true;
+    while (changed) {
+        changed = false;
+        for (std::size_t i = 0; i < framed.size(); i++) {
+            if (!framed[i])
+                continue;
+            for (auto successor: graph.successors(i)) {
+                if (successor != Graph::none && successor != epilogue && !framed[successor]) {
+                    framed[successor] = true;
+                    changed = true;
+                }
+            }
+            auto entered_without = i == 0 || std::any_of(predecessors[i].begin(), predecessors[i].end(),
+                                                         [&](std::size_t block) { return !framed[block]; });
+            auto entered_with = std::any_of(predecessors[i].begin(), predecessors[i].end(),
+                                            [&](std::size_t block) { return framed[block]; });
+            if (!entered_without || !entered_with)
+                continue;
+            for (auto predecessor: predecessors[i]) {
+                if (!framed[predecessor]) {
+                    framed[predecessor] = true;
+                    changed = true;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @return whether an instruction of a block names a register
+ */
+bool Frame::references(std::size_t block, Reg reg) const {
+    for (auto &instruction: function.blocks[block].instructions)
+        if (instruction.rd == reg || instruction.rs == reg || instruction.rt == reg)
+            return true;
+    return false;
+}
+
+/**
+ * Moves the values of callee-saved registers out of the blocks without the frame, where they cannot be saved first
+ * Each goes in a $t register that those blocks do not use, and is moved back where the frame is made
+ * A register that cannot be moved makes the blocks that use it need the frame
+ * @param moved the callee-saved registers that were moved, and the registers they were moved to
+ * @return whether every callee-saved register could be moved
+ */
+bool Frame::move_saved_registers(std::vector<std::pair<Reg, Reg>> &moved) {
+    std::vector<std::size_t> outside;
+    for (std::size_t i = 0; i < framed.size(); i++)
+        if (!framed[i] && i != epilogue)
+            outside.push_back(i);
+    auto used_outside = [&](Reg reg) {
+        return std::any_of(outside.begin(), outside.end(), [&](std::size_t block) { return references(block, reg); });
+    };
+
+    moved.clear();
+    std::vector<Reg> taken;
+    auto saved = callee_saved();
+    auto all_moved = true;
+    for (std::size_t reg = 0; reg < saved.size(); reg++) {
+        if (!saved.test(reg) || !used_outside(static_cast<Reg>(reg)))
+            continue;
+        auto to = std::find_if(std::begin(scratch), std::end(scratch), [&](Reg candidate) {
+            return !used_outside(candidate) && std::find(taken.begin(), taken.end(), candidate) == taken.end();
+        });
+        if (to != std::end(scratch)) {
+            taken.push_back(*to);
+            moved.emplace_back(static_cast<Reg>(reg), *to);
+            continue;
+        }
+        all_moved = false;
+        for (auto block: outside)
+            if (references(block, static_cast<Reg>(reg)))
+                needed[block] = true;
+    }
+    return all_moved;
+}
+
+/**
+ * Removes the frame at the end of each block with the frame that goes on to the epilogue, or at the start of the
+ * epilogue when every block before it has the frame
+ * @param removal the instructions that remove the frame
+ */
+void Frame::remove_before_epilogue(const std::vector<Instruction> &removal) {
+    auto &blocks = function.blocks;
+    auto &entering = predecessors[epilogue];
+    if (std::all_of(entering.begin(), entering.end(), [&](std::size_t block) { return framed[block]; })) {
+        auto &instructions = blocks[epilogue].instructions;
+        instructions.insert(instructions.begin(), removal.begin(), removal.end());
+        return;
+    }
+
+    // Later blocks are handled first, so inserting a block does not move the ones still to be handled
+    std::vector<std::size_t> leaving;
+    for (auto block: entering)
+        if (framed[block])
+            leaving.push_back(block);
+    std::sort(leaving.rbegin(), leaving.rend());
+    for (auto block: leaving) {
+        auto &instructions = blocks[block].instructions;
+        if (instructions.empty() || !instructions.back().is_terminator()) {
+            instructions.insert(instructions.end(), removal.begin(), removal.end());
+        } else if (instructions.back().op == Opcode::J) {
+            instructions.insert(instructions.end() - 1, removal.begin(), removal.end());
+        } else {
+            // A branch that falls through to the epilogue, which only gets an unlabeled block to fall through
+            Block between;
+            between.instructions = removal;
+            blocks.insert(blocks.begin() + static_cast<std::ptrdiff_t>(block) + 1, std::move(between));
+        }
+    }
+}
+
+/**
+ * Adds the frame to the blocks that need it
+ */
+void Frame::build() {
+    auto &blocks = function.blocks;
+    RegSet written;
+    auto calls = false;
+    for (auto &block: blocks) {
+        for (auto &instruction: block.instructions) {
+            calls |= instruction.op == Opcode::Jal;
+            written |= instruction.defs();
+        }
+    }
+    written &= callee_saved();
+
+    // A function that makes no calls and keeps nothing on the stack needs no frame
+    if (epilogue == Graph::none ||
+        (std::none_of(needed.begin(), needed.end(), [](bool need) { return need; }) && written.none()))
+        return;
+
+    std::vector<std::pair<Reg, Reg>> moved;
+    do
+        spread();
+    while (!move_saved_registers(moved));
+
+    // A branch straight to the epilogue cannot remove the frame on its way, so every path keeps the frame
+    for (auto block: predecessors[epilogue]) {
+        auto &instructions = blocks[block].instructions;
+        if (framed[block] && !instructions.empty() && instructions.back().is_terminator() &&
+            instructions.back().op != Opcode::J && graph.find(instructions.back().name) == epilogue) {
+            std::fill(framed.begin(), framed.end(), true);
+            moved.clear();
+            break;
+        }
+    }
+
+    for (auto &[from, to]: moved) {
+        for (std::size_t i = 0; i < blocks.size(); i++) {
+            if (framed[i])
+                continue;
+            for (auto &instruction: blocks[i].instructions)
+                for (auto reg: {&instruction.rd, &instruction.rs, &instruction.rt})
+                    if (*reg == from)
+                        *reg = to;
+        }
+    }
+
+    if (std::none_of(framed.begin(), framed.end(), [](bool frame) { return frame; }))
+        return;
+
+    std::vector<Instruction> making, removal;
+    making.push_back(Instruction::rri(Opcode::Subu, Reg::Sp, Reg::Sp, 0));
+    if (calls)
+        making.push_back(Instruction::store(Reg::Ra, {{}, Reg::Sp, 0}));
+    for (std::size_t reg = 0; reg < written.size(); reg++) {
+        if (!written.test(reg))
+            continue;
+        making.push_back(Instruction::store(static_cast<Reg>(reg), {{}, Reg::Sp, function.frame_size}));
+        removal.push_back(Instruction::load(static_cast<Reg>(reg), {{}, Reg::Sp, function.frame_size}));
+        function.frame_size += 4;
+    }
+    for (auto &[from, to]: moved)
+        making.push_back(Instruction::rr(Opcode::Move, from, to));
+    if (calls)
+        removal.push_back(Instruction::load(Reg::Ra, {{}, Reg::Sp, 0}));
+    removal.push_back(Instruction::rri(Opcode::Addu, Reg::Sp, Reg::Sp, function.frame_size));
+    making.front().imm = function.frame_size;
+
+    // Blocks are inserted before the epilogue, after the frame is made at the start of the blocks entered without it
+    for (std::size_t i = 0; i < blocks.size(); i++) {
+        auto entered_without = i == 0 || std::none_of(predecessors[i].begin(), predecessors[i].end(),
+                                                      [&](std::size_t block) { return framed[block]; });
+        if (framed[i] && entered_without)
+            blocks[i].instructions.insert(blocks[i].instructions.begin(), making.begin(), making.end());
+    }
+    remove_before_epilogue(removal);
+}
+
+}
+
+/**
+ * Adds the stack frame to a function whose registers are allocated (-O1)
+ * Only the paths that call a function or use a stack slot make the frame, so a function that does neither has none
+ * The frame holds $ra when the function makes calls, the slots of the register allocator, and the callee-saved
+ * registers the function writes
+ * @param function the function, which has no frame yet
+ */
+void build_frame(Function &function) {
+    Frame(function).build();
+}
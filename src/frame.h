@@ -0,0 +1,5 @@
+#pragma once
+
+#include "mir.h"
+
+void build_frame(Function &function);
@@ -1,4 +1,7 @@
+#include <fstream>
+#include <memory>
 #include "golf.h"
+#include "arena.h"
 #include "lexer.h"
 #include "file_input.h"
 #include "parser.h"
@@ -6,6 +9,7 @@
 #include "repl_input.h"
 #include "semantic.h"
 #include "code_gen.h"
+#include "constant_folder.h"
 
 /**
  * The main function of the program
@@ -17,38 +21,71 @@
  */
 int main(int argc, char* argv[]) {
     // Validate input
-    if (argc != 2)
+    std::string filename;
+    std::string output;
+    CodeGenOptions options;
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "-o" && i + 1 < argc && output.empty())
+            output = argv[++i];
+        else if (std::string(argv[i]) == "-O0" || std::string(argv[i]) == "-O1")
+            options.level = argv[i][2] - '0';
+        else if (std::string(argv[i]).rfind("-finline-limit=", 0) == 0)
+            options.inline_limit = std::atoi(argv[i] + std::string("-finline-limit=").size());
+        else if (filename.empty())
+            filename = argv[i];
+        else
+            filename = "";
+    }
+    if (filename.empty())
     {
-        printf("Usage: %s [filename]\n", argv[0]);
+        printf("Usage: %s [-O0|-O1] [-finline-limit=n] [-o output] [filename]\n", argv[0]);
         exit(EXIT_FAILURE);
     }
 
+    // The assembly goes to standard output unless an output file is given
+    std::ofstream output_file;
+    if (!output.empty()) {
+        output_file.open(output);
+        if (!output_file) {
+            std::cerr << "Cannot open output file " + output << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    std::ostream &out = output.empty() ? std::cout : output_file;
+
     // TODO: Make this not garbage
-    bool interactive = std::string(argv[1]) == "repl";
+    bool interactive = filename == "repl";
 
     do {
         // Read input
-        Input *input;
+        std::unique_ptr<Input> input;
         if(interactive)
-            input = new ReplInput();
+            input = std::make_unique<ReplInput>();
         else
-            input = new FileInput(argv[1]);
+            input = std::make_unique<FileInput>(filename);
         input->read();
 
-        // Lex input
-        Lexer lexer(input);
-        auto tokens = lexer.match_tokens(false);
+        // Everything allocated while compiling this input is released at once, at the end of the iteration
+        Arena arena;
 
-        // Parse tokens
-        Parser parser(input, tokens);
+        // Lex and parse input, tokens are streamed from the lexer into the parser
+        Interner symbols(arena);
+        Lexer lexer(input.get(), symbols);
+        Tree tree(arena);
+        Parser parser(input.get(), lexer, tree);
         auto ast = parser.parse(false);
 
         // Analyze syntax
-        Semantic semantic(input, *ast);
+        Semantic semantic(input.get(), ast);
         auto annotated_ast = semantic.analyze(false);
 
+        // Fold constant expressions
+        if (options.level >= 1)
+            ConstantFolder(annotated_ast).fold();
+
         // Generate code
-		generate_code(ast);
+        CodeGen code_gen(out, options);
+        code_gen.generate(ast);
     } while(interactive);
 
     return EXIT_SUCCESS;
@@ -0,0 +1,96 @@
+#include "inliner.h"
+
+/**
+ * Inliner class constructor
+ * @param root the annotated abstract syntax tree
+ * @param limit the largest size of a function that is expanded, 0 expands none
+ */
+Inliner::Inliner(AST root, int limit) : root(root), limit(limit) {
+    for (auto func: root.children())
+        if (func.kind() == NodeKind::Func)
+            functions[func.get_child(0).attr()].func = func;
+}
+
+/**
+ * Finds the functions whose calls are expanded
+ * @return the function nodes, by name
+ */
+std::unordered_map<std::string_view, AST> Inliner::inlined() {
+    std::unordered_map<std::string_view, AST> inlined;
+    if (limit <= 0)
+        return inlined;
+    for (auto &[name, callee]: functions) {
+        measure(name);
+        if (expanded(callee))
+            inlined[name] = callee.func;
+    }
+    return inlined;
+}
+
+/**
+ * Works out the size of a function, after the sizes of the functions it calls
+ * A call back to a function whose size is still being worked out closes a cycle, and every function on the cycle
+ * is recursive
+ * The calls are followed with an explicit stack, so a long chain of calls does not overflow the call stack
+ * @param name the name of the function
+ */
+void Inliner::measure(std::string_view name) {
+    if (functions[name].state != State::Unvisited)
+        return;
+    visit(name);
+    while (!visiting.empty()) {
+        auto &caller = visiting.back();
+        if (caller.next_call == caller.calls.size()) {
+            auto &callee = functions[caller.name];
+            callee.size = caller.size;
+            callee.state = State::Done;
+            visiting.pop_back();
+            if (!visiting.empty() && expanded(callee))
+                visiting.back().size += callee.size;
+            continue;
+        }
+
+        auto called = caller.calls[caller.next_call++];
+        auto &callee = functions[called];
+        if (callee.state == State::Visiting) {
+            for (auto it = visiting.rbegin(); it != visiting.rend(); it++) {
+                functions[it->name].recursive = true;
+                if (it->name == called)
+                    break;
+            }
+        } else if (callee.state == State::Done) {
+            if (expanded(callee))
+                caller.size += callee.size;
+        } else {
+            visit(called);
+        }
+    }
+}
+
+/**
+ * Starts working out the size of a function, counting the nodes of its body and collecting the user functions it
+ * calls in the order they are reached
+ * @param name the name of the function
+ */
+void Inliner::visit(std::string_view name) {
+    auto &callee = functions[name];
+    callee.state = State::Visiting;
+
+    Visit frame{name};
+    callee.func.get_child(2).pre([&](AST ast) {
+        frame.size++;
+        if (ast.kind() != NodeKind::FuncCall)
+            return;
+        auto called = functions.find(ast.get_child(0).attr());
+        if (called != functions.end())
+            frame.calls.push_back(called->first);
+    });
+    visiting.push_back(std::move(frame));
+}
+
+/**
+ * @return whether the calls to a function, whose size is worked out, are expanded
+ */
+bool Inliner::expanded(const Callee &callee) const {
+    return callee.state == State::Done && !callee.recursive && callee.size <= limit;
+}
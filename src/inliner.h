@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "ast.h"
+
+/**
+ * Decides which user functions are expanded in place of their calls (-O1)
+ * The size of a function is the number of nodes of its body, counting the bodies of the calls in it that are
+ * expanded in turn, and a function is expanded when that size is within the limit
+ * A function that can call itself, directly or through other functions, is never expanded
+ */
+class Inliner {
+public:
+    Inliner(AST root, int limit);
+    std::unordered_map<std::string_view, AST> inlined();
+
+private:
+    /**
+     * How far the size of a function is worked out
+     */
+    enum class State {
+        Unvisited,
+        Visiting,
+        Done,
+    };
+
+    /**
+     * A user function and its size
+     */
+    struct Callee {
+        AST func;
+        State state = State::Unvisited;
+        bool recursive = false;
+        int size = 0;
+    };
+
+    /**
+     * A function whose size is being worked out, and the calls in its body still to be measured
+     */
+    struct Visit {
+        std::string_view name;
+        std::vector<std::string_view> calls;
+        std::size_t next_call = 0;
+        int size = 0;
+    };
+
+    AST root;
+    int limit;
+    std::unordered_map<std::string_view, Callee> functions;
+    // The functions whose sizes are being worked out, each called by the one before it
+    std::vector<Visit> visiting;
+
+    void measure(std::string_view name);
+    void visit(std::string_view name);
+    bool expanded(const Callee &callee) const;
+};
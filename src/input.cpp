@@ -1,13 +1,27 @@
-#include <iostream>
-#include <sstream>
+#include <cstring>
 #include "input.h"
 
 Input::Input(const std::string& name) : name(name) {}
 
-std::string Input::get_line(int line_number) {
-    std::istringstream data_stream(data);
-    std::string line;
-    for(int i = 0; i < line_number; i++)
-        std::getline(data_stream, line);
-    return line;
+/**
+ * Returns the given line of the input, without its newline
+ * The offset of every line is indexed the first time a line is requested (usually for the first diagnostic),
+ * after which each lookup is a direct index
+ * @param line_number the 1-based line number
+ * @return a view of the line, or an empty view if there is no such line
+ */
+std::string_view Input::get_line(int line_number) {
+    if (line_starts.empty()) {
+        line_starts.push_back(0);
+        const char *begin = data.data();
+        const char *end = begin + data.length();
+        for (auto c = begin; (c = static_cast<const char *>(std::memchr(c, '\n', end - c))); c++)
+            line_starts.push_back(c - begin + 1);
+    }
+
+    if (line_number < 1 || line_number > line_starts.size())
+        return {};
+    int start = line_starts[line_number - 1];
+    int end = line_number < line_starts.size() ? line_starts[line_number] - 1 : data.length();
+    return data.substr(start, end - start);
 }
@@ -1,14 +1,19 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <vector>
 
 class Input {
 public:
-    std::string data;
+    std::string_view data;
     std::string name;
 
     Input(const std::string& name);
+    virtual ~Input() = default;
     virtual void read() = 0;
-    virtual std::string get_line(int line_number);
-};
+    virtual std::string_view get_line(int line_number);
 
+private:
+    std::vector<int> line_starts;
+};
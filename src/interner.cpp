@@ -0,0 +1,40 @@
+#include "interner.h"
+#include "universe.h"
+
+/**
+ * Interner class constructor
+ * Interns every universe name, in order, so that each one gets the id of its index in `universal_records`
+ * @param arena the arena of the compilation, which must outlive the interner
+ */
+Interner::Interner(Arena &arena) : ids(&arena), names(&arena) {
+    for (const auto &record: universal_records)
+        intern(record.name);
+}
+
+/**
+ * Gets the id of the given name, assigning the next id if the name has not been seen before
+ * @param name the identifier to intern
+ * @return the symbol id of the identifier
+ */
+SymbolId Interner::intern(std::string_view name) {
+    auto [iter, inserted] = ids.try_emplace(name, names.size());
+    if (inserted)
+        names.push_back(name);
+    return iter->second;
+}
+
+/**
+ * Gets the name that was interned as the given id
+ * @param symbol the symbol id
+ * @return a view of the identifier
+ */
+std::string_view Interner::name(SymbolId symbol) const {
+    return names[symbol];
+}
+
+/**
+ * @return the number of distinct identifiers interned so far
+ */
+std::size_t Interner::size() const {
+    return names.size();
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "arena.h"
+
+/**
+ * A dense id for an identifier, so that names can be compared and indexed without touching their characters
+ */
+using SymbolId = std::uint32_t;
+
+inline constexpr SymbolId no_symbol = UINT32_MAX;
+
+/**
+ * Maps identifiers to dense symbol ids
+ * The universe names are interned first, so their ids are fixed (see `universe_id`)
+ * Names are views, so they must outlive the interner (they are views into the source buffer)
+ */
+class Interner {
+public:
+    explicit Interner(Arena &arena);
+    SymbolId intern(std::string_view name);
+    std::string_view name(SymbolId symbol) const;
+    std::size_t size() const;
+
+private:
+    std::pmr::unordered_map<std::string_view, SymbolId> ids;
+    std::pmr::vector<std::string_view> names;
+};
@@ -1,19 +1,60 @@
-#include <set>
+#include <algorithm>
+#include <atomic>
+#include <thread>
 #include "lexer.h"
 #include "logger.h"
+#include "scanner.h"
 
 /**
  * Lexer class constructor
  * @param filereader pointer to a FileReader object
+ * @param symbols the interner that identifiers are interned into as they are handed out
  */
-Lexer::Lexer(Input *input) : input(input) { }
+Lexer::Lexer(Input *input, Interner &symbols) : input(input), symbols(&symbols), source(input->data) { }
+
+/**
+ * Constructs a lexer over a chunk of the input, used for parallel lexing
+ * The chunk must begin at the start of a line and end just after a newline (or at the end of the input)
+ * Line numbers are relative to the chunk, and diagnostics are not reported but reject the chunk
+ * @param input pointer to the input
+ * @param begin the position of the first character of the chunk
+ * @param end the position just past the last character of the chunk
+ */
+Lexer::Lexer(Input *input, int begin, int end) : start(begin), current(begin), input(input),
+                                                 source(input->data.substr(0, end)), in_chunk(true) { }
+
+/**
+ * Reports a warning, or rejects the chunk being lexed
+ * @param line line number of the warning
+ * @param column column number of the warning
+ * @param width width of the warning mark
+ * @param message the warning message
+ */
+void Lexer::warning(int line, int column, int width, const std::string &message) {
+    if (in_chunk)
+        throw Rejected();
+    Logger::warning(input, line, column, width, message);
+}
+
+/**
+ * Reports an error and exits, or rejects the chunk being lexed
+ * @param line line number of the error
+ * @param column column number of the error
+ * @param width width of the error mark
+ * @param message the error message
+ */
+void Lexer::error(int line, int column, int width, const std::string &message) {
+    if (in_chunk)
+        throw Rejected();
+    Logger::error(input, line, column, width, message);
+}
 
 /**
  * Check if lexer is at the end of the input
  * @return true if lexer is at the end of the input, false otherwise
  */
 bool Lexer::is_at_end() {
-    return current >= input->data.length();
+    return current >= source.length();
 }
 
 /**
@@ -22,7 +63,16 @@ bool Lexer::is_at_end() {
  */
 char Lexer::advance() {
     column++;
-    return input->data[current++];
+    return source[current++];
+}
+
+/**
+ * Advance the lexer to the given position on the current line
+ * @param position the position to advance to
+ */
+void Lexer::skip_to(int position) {
+    column += position - current;
+    current = position;
 }
 
 /**
@@ -33,7 +83,7 @@ char Lexer::advance() {
  * @return the created token
  */
 Token Lexer::create_token(TokenType token_type, int start, int end) {
-    return Token(token_type, input->data.substr(start, (end - start)), line, column - current + start);
+    return Token(token_type, source.substr(start, (end - start)), line, column - current + start);
 }
 
 /**
@@ -42,7 +92,7 @@ Token Lexer::create_token(TokenType token_type, int start, int end) {
  * @param lexeme the lexeme of the token
  * @return the created token
  */
-Token Lexer::create_token(TokenType token_type, std::string lexeme) {
+Token Lexer::create_token(TokenType token_type, std::string_view lexeme) {
     return Token(token_type, lexeme, line, column - current + start);
 }
 
@@ -72,24 +122,34 @@ TokenType Lexer::either(char expected, TokenType matched, TokenType unmatched) {
 
 /**
  * Returns the next character in the input without advancing the current position
- * @return the next character in the input
+ * The input may be a mapped file with nothing after it, so the end of the input reads as '\0'
+ * @return the next character in the input, or '\0' at the end of the input
  */
 char Lexer::peek() {
-    return input->data.at(current);
+    return is_at_end() ? '\0' : source[current];
 }
 
 /**
  * Infers if a semicolon token should be inserted
+ * Only depends on the last emitted token, so it works while streaming
  * @return the semicolon token if the last token is valid, otherwise nullopt
  */
 std::optional<Token> Lexer::infer_semicolon() {
-    const std::set<TokenType> valid = {
-            Identifier, Integer, String, Break, Return, RightParen, RightBracket
-    };
-    if (tokens.size() > 0)
-        if (valid.count(tokens.back().type))
+    if (!last.has_value())
+        return std::nullopt;
+
+    switch (last->type) {
+        case Identifier:
+        case Integer:
+        case String:
+        case Break:
+        case Return:
+        case RightParen:
+        case RightBracket:
             return create_token(Semicolon, "");
-    return std::nullopt;
+        default:
+            return std::nullopt;
+    }
 }
 
 /**
@@ -108,8 +168,7 @@ std::optional<Token> Lexer::newline() {
  * @return a token of type Integer
  */
 Token Lexer::number() {
-    while (!is_at_end() && is_digit(peek()))
-        advance();
+    skip_to(Scanner::skip_digits(source, current));
     return create_token(Integer);
 }
 
@@ -118,13 +177,10 @@ Token Lexer::number() {
  * @return a token of type Identifier or Keyword
  */
 Token Lexer::identifier() {
-    while (!is_at_end() && is_alphanumeric(peek()))
-        advance();
+    skip_to(Scanner::skip_alphanumeric(source, current));
 
-    auto lexeme = input->data.substr(start, (current - start));
-    if (Keywords.count(lexeme))
-        return create_token(Keywords[lexeme]);
-    return create_token(Identifier);
+    auto lexeme = source.substr(start, (current - start));
+    return create_token(keyword(lexeme));
 }
 
 /**
@@ -142,7 +198,7 @@ Token Lexer::create_token(TokenType token_type) {
  * @return true if the character is a digit, false otherwise
  */
 bool Lexer::is_digit(char c) {
-    return c >= '0' && c <= '9';
+    return Scanner::is(c, Digit);
 }
 
 /**
@@ -151,9 +207,7 @@ bool Lexer::is_digit(char c) {
  * @return true if the character is alpha, false otherwise
  */
 bool Lexer::is_alpha(char c) {
-    return (c >= 'a' && c <= 'z') ||
-           (c >= 'A' && c <= 'Z') ||
-           c == '_';
+    return Scanner::is(c, Alpha);
 }
 
 /**
@@ -162,29 +216,181 @@ bool Lexer::is_alpha(char c) {
  * @return true if the character is alphanumeric, false otherwise
  */
 bool Lexer::is_alphanumeric(char c) {
-    return is_alpha(c) || is_digit(c);
+    return Scanner::is(c, Alphanumeric);
+}
+
+/**
+ * Remembers the given token as the last emitted one, which drives semicolon inference
+ * @param token the token being emitted
+ * @return the emitted token
+ */
+Token Lexer::emit(Token token) {
+    last = token;
+    return token;
+}
+
+/**
+ * Matches tokens from the input until one is produced
+ * When the end of the input string is reached, a closing semicolon is inferred (if needed) followed by an Eof token
+ * Once the end has been reached, every further call returns another Eof token
+ * Tokens view into the input buffer, so the input must outlive them
+ * Identifiers are interned as they are handed out, the parallel chunk lexers never intern
+ * @return the next token
+ */
+Token Lexer::next_token() {
+    auto token = scan_token();
+    if (token.type == Identifier)
+        token.symbol = symbols->intern(token.lexeme);
+    return token;
+}
+
+/**
+ * Lexes the next token from the input, without interning it
+ * @return the next token
+ */
+Token Lexer::scan_token() {
+    while (!is_at_end()) {
+        start = current;
+        auto token = match_token();
+        if (token.has_value())
+            return emit(token.value());
+    }
+    auto closing_semicolon = infer_semicolon();
+    if (closing_semicolon.has_value())
+        return emit(closing_semicolon.value());
+    return emit(create_token(Eof, current, current));
 }
 
 /**
  * Iterates through the input string, matching a token at each iteration
  * When the end of the input string is reached, the function adds a Eof token to the tokens vector and returns it
+ * The parser pulls tokens with `next_token` instead, this is only needed to list every token up front
  * @param verbose should the token be printed
  * @return a vector of all the matched tokens
 */
 std::vector<Token> Lexer::match_tokens(bool verbose) {
+    std::vector<Token> tokens;
+    do {
+        tokens.push_back(next_token());
+        if (verbose)
+            std::cout << tokens.back() << std::endl;
+    } while (tokens.back().type != Eof);
+    return tokens;
+}
+
+/**
+ * Lexes a chunk of the input, without knowing the token that precedes it
+ * Semicolon inference (at a newline, or before a "}") is the only thing that depends on the previous token,
+ * and only until this chunk emits its first token. The "head" of the chunk, up to the first newline after that
+ * token, is therefore recorded so it can be lexed again once the previous token is known
+ * @return the tokens of the chunk, with line numbers relative to the chunk
+ */
+std::vector<Token> Lexer::match_chunk() {
+    std::vector<Token> tokens;
     while (!is_at_end()) {
         start = current;
+        auto settled = last.has_value();
+        auto previous_line = line;
         auto token = match_token();
-        if (token.has_value()) {
-            tokens.push_back(token.value());
-            if (verbose)
-                std::cout << token.value() << std::endl;
+        if (token.has_value())
+            tokens.push_back(emit(token.value()));
+        if (settled && line != previous_line && head_end < 0) {
+            head_end = current;
+            head_tokens = tokens.size();
         }
     }
-    auto closing_semicolon = infer_semicolon();
-    if(closing_semicolon.has_value())
-        tokens.push_back(closing_semicolon.value());
-    tokens.push_back(create_token(Eof, current, current));
+    if (head_end < 0) {
+        head_end = current;
+        head_tokens = tokens.size();
+    }
+    return tokens;
+}
+
+/**
+ * Lexes the input on multiple threads, producing exactly the same tokens as `match_tokens`
+ * The input is split into chunks at line boundaries, where no string or comment can be open
+ * Each chunk is lexed independently, then the seams are fixed up in order: the head of every chunk is lexed again
+ * knowing the previous token (which redoes semicolon inference), and line numbers are offset
+ * If any chunk runs into a diagnostic the whole input is lexed serially instead, so diagnostics are unchanged
+ * The whole token list is built before it is returned, so the compiler itself streams tokens with `next_token`
+ * @param threads the number of chunks to lex concurrently
+ * @return a vector of all the matched tokens
+ */
+std::vector<Token> Lexer::match_tokens_parallel(int threads) {
+    // Split the input after the first newline following each even share of the input
+    std::vector<int> bounds = {0};
+    for (int i = 1; i < threads; i++) {
+        auto target = std::max<size_t>(bounds.back(), (size_t) source.length() * i / threads);
+        auto newline = source.find('\n', target);
+        if (newline == std::string_view::npos)
+            break;
+        if (newline + 1 > bounds.back())
+            bounds.push_back(newline + 1);
+    }
+    if (bounds.back() < source.length())
+        bounds.push_back(source.length());
+    if (bounds.size() < 3)
+        return match_tokens(false);
+
+    // Lex every chunk concurrently
+    auto chunk_count = bounds.size() - 1;
+    std::vector<Lexer> lexers;
+    std::vector<std::vector<Token>> chunks(chunk_count);
+    for (int i = 0; i < chunk_count; i++)
+        lexers.push_back(Lexer(input, bounds[i], bounds[i + 1]));
+    std::atomic<bool> rejected = false;
+    std::vector<std::thread> workers;
+    for (int i = 0; i < chunk_count; i++)
+        workers.emplace_back([&, i]() {
+            try {
+                chunks[i] = lexers[i].match_chunk();
+            } catch (Rejected &) {
+                rejected = true;
+            }
+        });
+    for (auto &worker: workers)
+        worker.join();
+    if (rejected)
+        return match_tokens(false);
+
+    // Stitch the chunks together
+    std::vector<Token> tokens;
+    size_t total = 0;
+    for (auto &chunk: chunks)
+        total += chunk.size();
+    tokens.reserve(total + 2);
+
+    int line_offset = 0;
+    Lexer *tail = nullptr;
+    std::optional<Lexer> head;
+    for (int i = 0; i < chunk_count; i++) {
+        auto &lexer = lexers[i];
+        auto &chunk = chunks[i];
+
+        // Lex the head again, continuing from the previous token
+        head.emplace(Lexer(input, bounds[i], lexer.head_end));
+        head->line = line_offset + 1;
+        head->last = tokens.empty() ? std::nullopt : std::optional<Token>(tokens.back());
+        auto head_chunk = head->match_chunk();
+        tokens.insert(tokens.end(), head_chunk.begin(), head_chunk.end());
+
+        // The rest of the chunk only needs its line numbers offset
+        for (int j = lexer.head_tokens; j < chunk.size(); j++) {
+            chunk[j].line += line_offset;
+            tokens.push_back(chunk[j]);
+        }
+
+        tail = lexer.head_end == bounds[i + 1] ? &head.value() : &lexer;
+        line_offset += lexer.line - 1;
+    }
+
+    // Finish off from the state of whichever lexer lexed the end of the input
+    tail->line = line_offset + 1;
+    tail->last = tokens.empty() ? std::nullopt : std::optional<Token>(tokens.back());
+    tail->in_chunk = false;
+    do
+        tokens.push_back(tail->next_token());
+    while (tokens.back().type != Eof);
 
     return tokens;
 }
@@ -198,7 +404,7 @@ std::optional<Token> Lexer::match_token() {
 
     // Ugly approach to allow complex statements to occupy a single line
     // TODO: Refactor this lmao
-    if(c == '}' && tokens.back().type != Semicolon) {
+    if(c == '}' && last.has_value() && last->type != Semicolon) {
         current--;
         return create_token(Semicolon);
     }
@@ -207,7 +413,9 @@ std::optional<Token> Lexer::match_token() {
         // Whitespace
         case ' ':
         case '\r':
-        case '\t': return std::nullopt;
+        case '\t':
+            skip_to(Scanner::skip_whitespace(source, current));
+            return std::nullopt;
 
         // Newline (with semicolon inference)
         case '\n': return newline();
@@ -236,18 +444,17 @@ std::optional<Token> Lexer::match_token() {
             if (match('&'))
                 return create_token(And);
             else
-                Logger::error(input, line, column, 1, "bitwise AND not supported");
+                error(line, column, 1, "bitwise AND not supported");
         case '|':
             if (match('|'))
                 return create_token(Or);
             else
-                Logger::error(input, line, column, 1, "bitwise OR not supported");
+                error(line, column, 1, "bitwise OR not supported");
 
         // Comment
         case '/':
             if (match('/')) {
-                while (!is_at_end() && peek() != '\n')
-                    advance();
+                skip_to(Scanner::skip_comment(source, current));
                 return std::nullopt;
             } else
                 return create_token(Divide);
@@ -255,21 +462,24 @@ std::optional<Token> Lexer::match_token() {
         // String literal
         case '"':
             while (!is_at_end() && peek() != '"') {
+                skip_to(Scanner::skip_string(source, current));
+                if (is_at_end() || peek() == '"')
+                    break;
                 if (match('\\'))
                     if (match('b') || match('f') || match('n') || match('r') ||
                         match('t') || match('\\') || match('\"'))
                         continue;
                     else
-                        Logger::error(input, line, column, 2,
+                        error(line, column, 2,
                               "bad string escape '\\" + std::string(1, peek()) + "'");
                 if (peek() == '\n')
-                    Logger::error(input, line, column - current + start + 1, current - start + 1,
+                    error(line, column - current + start + 1, current - start + 1,
                           "string contains newline");
                 advance();
             }
 
             if (is_at_end())
-                Logger::error(input, line, column - current + start + 1, current - start + 1, "unterminated string");
+                error(line, column - current + start + 1, current - start + 1, "unterminated string");
 
             advance();
             return create_token(String, start + 1, current - 1);
@@ -286,11 +496,11 @@ std::optional<Token> Lexer::match_token() {
 
             // Non-ascii character
             else if (!isascii(c))
-                Logger::warning(input, line, column, 1, "skipping non-ascii character");
+                warning(line, column, 1, "skipping non-ascii character");
 
             // Unknown
             else
-                Logger::warning(input, line, column, 1, "skipping unknown character '" + std::string(1, c) + "'");
+                warning(line, column, 1, "skipping unknown character '" + std::string(1, c) + "'");
     }
 
     // Couldn't match any character, ignore
@@ -3,27 +3,48 @@
 #include <string>
 #include <vector>
 #include <optional>
+#include <string_view>
 #include "token.h"
 #include "file_input.h"
 #include "input.h"
+#include "interner.h"
 
 class Lexer {
 public:
-    Lexer(Input* input);
+    Lexer(Input* input, Interner &symbols);
+    Token next_token();
     std::vector<Token> match_tokens(bool verbose);
+    std::vector<Token> match_tokens_parallel(int threads);
 
 private:
+    // Thrown by chunk lexers instead of reporting a diagnostic
+    struct Rejected {};
+
     int start = 0;
     int current = 0;
     int line = 1;
     int column = 1;
     Input *input;
-    std::vector<Token> tokens;
+    Interner *symbols = nullptr;
+    std::string_view source;
+    std::optional<Token> last;
+
+    // Chunk lexing state (see `match_chunk`)
+    bool in_chunk = false;
+    int head_end = -1;
+    int head_tokens = 0;
 
+    Lexer(Input *input, int begin, int end);
+    std::vector<Token> match_chunk();
+    Token scan_token();
+    void warning(int line, int column, int width, const std::string &message);
+    void error(int line, int column, int width, const std::string &message);
     bool is_at_end();
+    Token emit(Token token);
     char advance();
+    void skip_to(int position);
     Token create_token(TokenType token_type);
-    Token create_token(TokenType token_type, std::string lexeme);
+    Token create_token(TokenType token_type, std::string_view lexeme);
     Token create_token(TokenType token_type, int start, int end);
     bool match(char expected);
     TokenType either(char expected, TokenType matched, TokenType unmatched);
@@ -19,7 +19,7 @@ void Logger::log(std::ostream &ostream, Input *input, int line, int column, int
     // File name and location
     ostream << "--> " << input->name << ":" << line << ":" << column << std::endl;
 
-    // Extract error line
+    // Extract error line (a view into the input)
     auto error_line = input->get_line(line);
 
     if (!is_printable(error_line)) {
@@ -118,7 +118,7 @@ void Logger::print_line(std::ostream &ostream, std::string content, int line, in
  * @param str the string to check
  * @return true if the string is printable, false otherwise
 */
-bool Logger::is_printable(const std::string &str) {
+bool Logger::is_printable(std::string_view str) {
     for (char c: str)
         if (!std::isprint(c) && c != '\t')
             return false;
@@ -132,7 +132,7 @@ bool Logger::is_printable(const std::string &str) {
  * @param end_column the column where we stop adding indentation
  * @return a tuple with the normalized string and additional indentation
 */
-std::tuple<std::string, int> Logger::normalize_line(const std::string &str, int end_column) {
+std::tuple<std::string, int> Logger::normalize_line(std::string_view str, int end_column) {
     std::string normalized = "";
     auto indent = 0;
     for (int i = 0; i < str.length(); i++) {
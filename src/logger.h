@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <tuple>
 #include "file_input.h"
 #include "input.h"
@@ -17,7 +18,7 @@ private:
     static void print_line(std::ostream& ostream, std::string content, int indent);
     static void print_line(std::ostream& ostream, std::string content, int line, int indent);
     static std::string get_line(std::ifstream& filestream, int line);
-    static bool is_printable(const std::string &str);
-    static std::tuple<std::string, int> normalize_line(const std::string &str, int end_column);
+    static bool is_printable(std::string_view str);
+    static std::tuple<std::string, int> normalize_line(std::string_view str, int end_column);
 };
 
@@ -0,0 +1,441 @@
+#include <algorithm>
+#include <array>
+
+#include "mir.h"
+#include "asm_writer.h"
+
+/**
+ * Gets the register that passes an argument
+ * @param index the index of the argument
+ * @return $a0, $a1, ... in order, past $a3 these are only names
+ */
+Reg argument(int index) {
+    return static_cast<Reg>(static_cast<int>(Reg::A0) + index);
+}
+
+/**
+ * Gets a virtual register
+ * @param index the number of the virtual register within its function
+ * @return the register
+ */
+Reg virtual_register(int index) {
+    return static_cast<Reg>(first_virtual + index);
+}
+
+/**
+ * @return whether a register is virtual, and has to be replaced by a machine register
+ */
+bool is_virtual(Reg reg) {
+    return static_cast<std::uint32_t>(reg) >= first_virtual;
+}
+
+/**
+ * Gets the registers that a function has to leave as it found them, with optimization
+ * Functions save the ones they use on entry and restore them on exit, so values in them survive calls
+ * @return $s0 to $s8
+ */
+RegSet callee_saved() {
+    RegSet set;
+    for (auto reg = static_cast<std::size_t>(Reg::S0); reg <= static_cast<std::size_t>(Reg::S8); reg++)
+        set.set(reg);
+    return set;
+}
+
+/**
+ * Gets the assembly name of a register
+ * @param reg the register
+ * @return the name of the register, including the "$"
+ */
+std::string_view name(Reg reg) {
+    static const auto names = [] {
+        std::array<std::string, 256> names = {
+                "", "$0", "$v0", "$v1", "$sp", "$ra",
+                "$t0", "$t1", "$t2", "$t3", "$t4", "$t5", "$t6", "$t7", "$t8", "$t9",
+                "$s0", "$s1", "$s2", "$s3", "$s4", "$s5", "$s6", "$s7", "$s8",
+        };
+        for (int i = static_cast<int>(Reg::A0); i < names.size(); i++)
+            names[i] = "$a" + std::to_string(i - static_cast<int>(Reg::A0));
+        return names;
+    }();
+    return names[static_cast<std::size_t>(reg)];
+}
+
+/**
+ * Gets the mnemonic of an opcode
+ * @param op the opcode
+ * @return the mnemonic, as printed in the assembly
+ */
+std::string_view name(Opcode op) {
+    switch (op) {
+        case Opcode::Li: return "li";
+        case Opcode::La: return "la";
+        case Opcode::Lw: return "lw";
+        case Opcode::Sw: return "sw";
+        case Opcode::Move: return "move";
+        case Opcode::Negu: return "negu";
+        case Opcode::Addu: return "addu";
+        case Opcode::Subu: return "subu";
+        case Opcode::Mul: return "mul";
+        case Opcode::Mulhi: return "mulhi";
+        case Opcode::Div: return "div";
+        case Opcode::Rem: return "rem";
+        case Opcode::Seq: return "seq";
+        case Opcode::Sne: return "sne";
+        case Opcode::Slt: return "slt";
+        case Opcode::Sltu: return "sltu";
+        case Opcode::Sle: return "sle";
+        case Opcode::Sgt: return "sgt";
+        case Opcode::Sge: return "sge";
+        case Opcode::Xori: return "xori";
+        case Opcode::Sll: return "sll";
+        case Opcode::Sra: return "sra";
+        case Opcode::Srl: return "srl";
+        case Opcode::J: return "j";
+        case Opcode::Jal: return "jal";
+        case Opcode::Jr: return "jr";
+        case Opcode::Jtab: return "jr";
+        case Opcode::Beqz: return "beqz";
+        case Opcode::Bnez: return "bnez";
+    }
+    return "";
+}
+
+Name Name::function(std::string_view name) {
+    return {NameKind::Function, 0, name};
+}
+
+Name Name::epilogue(std::string_view function) {
+    return {NameKind::Epilogue, 0, function};
+}
+
+Name Name::literal(std::string_view text) {
+    return {NameKind::Literal, 0, text};
+}
+
+bool Name::operator==(const Name &other) const {
+    return kind == other.kind && number == other.number && text == other.text;
+}
+
+/**
+ * @return the name as printed in the assembly
+ */
+std::string Name::to_string() const {
+    switch (kind) {
+        case NameKind::None: return "";
+        case NameKind::Label: return "L" + std::to_string(number);
+        case NameKind::Global: return "G" + std::to_string(number);
+        case NameKind::String: return "S" + std::to_string(number);
+        case NameKind::Function: return std::string(text);
+        case NameKind::Epilogue: return std::string(text) + "_epilogue";
+        case NameKind::Literal: return std::string(text);
+    }
+    return "";
+}
+
+Instruction Instruction::rr(Opcode op, Reg rd, Reg rs) {
+    return {op, rd, rs};
+}
+
+Instruction Instruction::rrr(Opcode op, Reg rd, Reg rs, Reg rt) {
+    return {op, rd, rs, rt};
+}
+
+Instruction Instruction::rri(Opcode op, Reg rd, Reg rs, int imm) {
+    return {op, rd, rs, Reg::None, imm};
+}
+
+Instruction Instruction::rn(Opcode op, Reg rd, Name name) {
+    return {op, rd, Reg::None, Reg::None, 0, name};
+}
+
+Instruction Instruction::load(Reg rd, Address address) {
+    return {Opcode::Lw, rd, address.base, Reg::None, address.offset, address.global};
+}
+
+Instruction Instruction::store(Reg rt, Address address) {
+    return {Opcode::Sw, Reg::None, address.base, rt, address.offset, address.global};
+}
+
+Instruction Instruction::jump(Opcode op, Name target) {
+    return {op, Reg::None, Reg::None, Reg::None, 0, target};
+}
+
+Instruction Instruction::branch(Opcode op, Reg rs, Name target) {
+    return {op, Reg::None, rs, Reg::None, 0, target};
+}
+
+Instruction Instruction::jr(Reg rs) {
+    return {Opcode::Jr, Reg::None, rs};
+}
+
+/**
+ * @return whether the instruction ends a block, calls return to the same block so they do not
+ */
+bool Instruction::is_terminator() const {
+    switch (op) {
+        case Opcode::J:
+        case Opcode::Jr:
+        case Opcode::Jtab:
+        case Opcode::Beqz:
+        case Opcode::Bnez:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @return whether the instruction only writes its destination register, so it can be removed if that is never read
+ */
+bool Instruction::is_pure() const {
+    switch (op) {
+        case Opcode::Li:
+        case Opcode::La:
+        case Opcode::Lw:
+        case Opcode::Move:
+        case Opcode::Negu:
+        case Opcode::Addu:
+        case Opcode::Subu:
+        case Opcode::Mul:
+        case Opcode::Mulhi:
+        case Opcode::Seq:
+        case Opcode::Sne:
+        case Opcode::Slt:
+        case Opcode::Sltu:
+        case Opcode::Sle:
+        case Opcode::Sgt:
+        case Opcode::Sge:
+        case Opcode::Xori:
+        case Opcode::Sll:
+        case Opcode::Sra:
+        case Opcode::Srl:
+            return rd != Reg::Sp;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Gets the registers the instruction may read
+ * Returning reads $v0, the stack pointer, the return address and the callee-saved registers, callers keep every other
+ * value they need across the call themselves (see `allocate_registers`), while jumping to another function reads
+ * every register
+ * A call reads the argument registers and the stack pointer
+ * @return the registers read
+ */
+RegSet Instruction::uses() const {
+    RegSet set;
+    switch (op) {
+        case Opcode::Jal:
+            for (auto i = static_cast<std::size_t>(Reg::A0); i < set.size(); i++)
+                set.set(i);
+            set.set(static_cast<std::size_t>(Reg::Sp));
+            break;
+        case Opcode::Jr:
+            set.set(static_cast<std::size_t>(rs));
+            set.set(static_cast<std::size_t>(Reg::V0));
+            set.set(static_cast<std::size_t>(Reg::Sp));
+            set |= callee_saved();
+            break;
+        case Opcode::J:
+            if (name.kind == NameKind::Function)
+                set.set();
+            break;
+        default:
+            set.set(static_cast<std::size_t>(rs));
+            set.set(static_cast<std::size_t>(rt));
+            break;
+    }
+    set.reset(static_cast<std::size_t>(Reg::None));
+    return set;
+}
+
+/**
+ * Gets the registers the instruction always writes
+ * A call is only certain to write $ra, the callee may leave any other register as it was
+ * @return the registers written
+ */
+RegSet Instruction::defs() const {
+    RegSet set;
+    if (op == Opcode::Jal)
+        set.set(static_cast<std::size_t>(Reg::Ra));
+    else if (op != Opcode::Sw && !is_terminator())
+        set.set(static_cast<std::size_t>(rd));
+    set.reset(static_cast<std::size_t>(Reg::None));
+    return set;
+}
+
+/**
+ * Gets the registers the instruction may write
+ * @return the registers written, which is every register for a call
+ */
+RegSet Instruction::clobbers() const {
+    if (op == Opcode::Jal)
+        return RegSet().set().reset(static_cast<std::size_t>(Reg::None));
+    return defs();
+}
+
+/**
+ * Appends an instruction to the last block, starting a new block after a terminator
+ * @param instruction the instruction to append
+ */
+void Function::append(const Instruction &instruction) {
+    if (blocks.empty() || (!blocks.back().instructions.empty() && blocks.back().instructions.back().is_terminator()))
+        blocks.emplace_back();
+    blocks.back().instructions.push_back(instruction);
+}
+
+/**
+ * Starts a new block at a label, reusing the last block if it is still empty and unlabeled
+ * @param label the label of the new block
+ */
+void Function::place(Name label) {
+    if (blocks.empty() || !blocks.back().instructions.empty() || blocks.back().label.kind != NameKind::None)
+        blocks.emplace_back();
+    blocks.back().label = label;
+}
+
+Graph::Graph(const Function &function): function(function) {
+    for (std::size_t i = 0; i < function.blocks.size(); i++) {
+        auto &label = function.blocks[i].label;
+        if (label.kind == NameKind::Label)
+            labels[label.number] = i;
+        else if (label.kind == NameKind::Epilogue)
+            epilogue = i;
+    }
+    edges.reserve(function.blocks.size());
+    for (std::size_t i = 0; i < function.blocks.size(); i++)
+        edges.push_back(find_successors(i));
+}
+
+/**
+ * @param target the target of a jump or branch
+ * @return the block it enters, or `none` if it leaves the function
+ */
+std::size_t Graph::find(const Name &target) const {
+    if (target.kind == NameKind::Epilogue)
+        return epilogue;
+    if (target.kind != NameKind::Label)
+        return none;
+    auto block = labels.find(target.number);
+    return block == labels.end() ? none : block->second;
+}
+
+/**
+ * @param block a block
+ * @return the blocks control may go to from the end of the block, `none` for leaving the function
+ */
+const Graph::Successors &Graph::successors(std::size_t block) const {
+    return edges[block];
+}
+
+Graph::Successors Graph::find_successors(std::size_t block) const {
+    Successors successors;
+    auto &instructions = function.blocks[block].instructions;
+    auto next = block + 1 < function.blocks.size() ? block + 1 : none;
+    if (instructions.empty() || !instructions.back().is_terminator()) {
+        successors.add(next);
+        return successors;
+    }
+    auto &last = instructions.back();
+    switch (last.op) {
+        case Opcode::Beqz:
+        case Opcode::Bnez:
+            successors.add(next);
+            [[fallthrough]];
+        case Opcode::J:
+            if (last.name.kind != NameKind::Function)
+                successors.add(find(last.name));
+            break;
+        case Opcode::Jtab:
+            for (auto &target: function.tables[last.imm].targets) {
+                auto entered = find(target);
+                if (std::find(successors.table.begin(), successors.table.end(), entered) == successors.table.end())
+                    successors.table.push_back(entered);
+            }
+            break;
+        default:
+            break;
+    }
+    return successors;
+}
+
+/**
+ * Prints an instruction in the exact form the code generator has always produced
+ * @param instruction the instruction to print
+ * @param writer the assembly output
+ */
+void print(const Instruction &instruction, AsmWriter &writer) {
+    auto op = name(instruction.op);
+    switch (instruction.op) {
+        case Opcode::Li:
+            if (instruction.name.kind != NameKind::None)
+                writer.line("    li ", instruction.rd, ",", instruction.name);
+            else
+                writer.line("    li ", instruction.rd, ",", instruction.imm);
+            break;
+        case Opcode::La:
+            writer.line("    la ", instruction.rd, ",", instruction.name);
+            break;
+        case Opcode::Lw:
+        case Opcode::Sw: {
+            auto reg = instruction.op == Opcode::Lw ? instruction.rd : instruction.rt;
+            if (instruction.name.kind != NameKind::None && instruction.rs != Reg::None)
+                writer.line("    ", op, " ", reg, ",", instruction.name, "(", instruction.rs, ")");
+            else if (instruction.name.kind != NameKind::None)
+                writer.line("    ", op, " ", reg, ",", instruction.name);
+            else if (instruction.rs != Reg::None)
+                writer.line("    ", op, " ", reg, ",", instruction.imm, "(", instruction.rs, ")");
+            else
+                writer.line("    ", op, " ", reg, ",");
+            break;
+        }
+        case Opcode::Move:
+        case Opcode::Negu:
+            writer.line("    ", op, " ", instruction.rd, ",", instruction.rs);
+            break;
+        case Opcode::J:
+        case Opcode::Jal:
+            writer.line("    ", op, " ", instruction.name);
+            break;
+        case Opcode::Jr:
+        case Opcode::Jtab:
+            writer.line("    jr ", instruction.rs);
+            break;
+        case Opcode::Mulhi:
+            writer.line("    mult ", instruction.rs, ",", instruction.rt);
+            writer.line("    mfhi ", instruction.rd);
+            break;
+        case Opcode::Beqz:
+        case Opcode::Bnez:
+            writer.line("    ", op, " ", instruction.rs, ",", instruction.name);
+            break;
+        default:
+            if (instruction.rt != Reg::None)
+                writer.line("    ", op, " ", instruction.rd, ",", instruction.rs, ",", instruction.rt);
+            else
+                writer.line("    ", op, " ", instruction.rd, ",", instruction.rs, ",", instruction.imm);
+            break;
+    }
+}
+
+/**
+ * Prints the blocks of a function in layout order, followed by its jump tables
+ * @param function the function to print
+ * @param writer the assembly output
+ */
+void print(const Function &function, AsmWriter &writer) {
+    for (auto &block: function.blocks) {
+        if (block.label.kind != NameKind::None)
+            writer.line(block.label, ":");
+        for (auto &instruction: block.instructions)
+            print(instruction, writer);
+    }
+    for (auto &table: function.tables) {
+        writer.line("    .data");
+        writer.line(table.label, ":");
+        for (auto &target: table.targets)
+            writer.line("    .word ", target);
+        writer.line("    .text");
+    }
+}
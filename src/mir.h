@@ -0,0 +1,218 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class AsmWriter;
+
+/**
+ * A MIPS register
+ * The argument registers come last, so the registers of any number of arguments can be named (see `argument`)
+ * `None` is a register that was never assigned, it prints as nothing
+ * Past the names of the machine registers are the virtual registers, which are replaced by machine registers before
+ * the function is printed (see `virtual_register`)
+ */
+enum class Reg : std::uint32_t {
+    None,
+    Zero,
+    V0,
+    V1,
+    Sp,
+    Ra,
+    T0, T1, T2, T3, T4, T5, T6, T7, T8, T9,
+    S0, S1, S2, S3, S4, S5, S6, S7, S8,
+    A0,
+};
+
+Reg argument(int index);
+
+// The first virtual register, every machine register and argument register name comes before it
+constexpr std::uint32_t first_virtual = 256;
+
+Reg virtual_register(int index);
+bool is_virtual(Reg reg);
+
+std::string_view name(Reg reg);
+
+/**
+ * A set of registers, indexed by `Reg`
+ */
+using RegSet = std::bitset<256>;
+
+RegSet callee_saved();
+
+/**
+ * The instructions that functions are lowered to
+ */
+enum class Opcode : std::uint8_t {
+    Li,
+    La,
+    Lw,
+    Sw,
+    Move,
+    Negu,
+    Addu,
+    Subu,
+    Mul,
+    // The high word of the 64-bit product, printed as `mult` and `mfhi` so HI is never live between instructions
+    Mulhi,
+    Div,
+    Rem,
+    Seq,
+    Sne,
+    Slt,
+    Sltu,
+    Sle,
+    Sgt,
+    Sge,
+    Xori,
+    Sll,
+    Sra,
+    Srl,
+    J,
+    Jal,
+    Jr,
+    // A jump to an address loaded from a jump table of the function, imm is the index of the table
+    Jtab,
+    Beqz,
+    Bnez,
+};
+
+std::string_view name(Opcode op);
+
+enum class NameKind : std::uint8_t {
+    None,
+    Label,
+    Global,
+    String,
+    Function,
+    Epilogue,
+    Literal,
+};
+
+/**
+ * A symbolic operand: a generated label or global ("L3", "G0", "S2"), a function or its epilogue,
+ * or a literal that is printed as written ("-12", "Ltrue")
+ */
+struct Name {
+    NameKind kind = NameKind::None;
+    int number = 0;
+    std::string_view text;
+
+    static Name function(std::string_view name);
+    static Name epilogue(std::string_view function);
+    static Name literal(std::string_view text);
+    bool operator==(const Name &other) const;
+    std::string to_string() const;
+};
+
+/**
+ * A memory operand, a global, an offset from a base register, or a global indexed by a base register
+ * The default address has none, and prints as nothing
+ */
+struct Address {
+    Name global;
+    Reg base = Reg::None;
+    int offset = 0;
+};
+
+/**
+ * A single machine instruction
+ *   rd is the register written, rs and rt are the registers read (rt is the register stored by `sw`)
+ *   imm is an immediate operand, or the offset of a memory operand
+ *   name is a branch target, a called function, a loaded address, a global or a literal value
+ */
+struct Instruction {
+    Opcode op;
+    Reg rd = Reg::None;
+    Reg rs = Reg::None;
+    Reg rt = Reg::None;
+    int imm = 0;
+    Name name;
+
+    static Instruction rr(Opcode op, Reg rd, Reg rs);
+    static Instruction rrr(Opcode op, Reg rd, Reg rs, Reg rt);
+    static Instruction rri(Opcode op, Reg rd, Reg rs, int imm);
+    static Instruction rn(Opcode op, Reg rd, Name name);
+    static Instruction load(Reg rd, Address address);
+    static Instruction store(Reg rt, Address address);
+    static Instruction jump(Opcode op, Name target);
+    static Instruction branch(Opcode op, Reg rs, Name target);
+    static Instruction jr(Reg rs);
+
+    bool is_terminator() const;
+    bool is_pure() const;
+    RegSet uses() const;
+    RegSet defs() const;
+    RegSet clobbers() const;
+};
+
+/**
+ * A straight-line run of instructions, entered only at the top and left only at the bottom
+ * Only blocks that are jumped to have a label
+ */
+struct Block {
+    Name label;
+    std::vector<Instruction> instructions;
+};
+
+/**
+ * The words of a jump table, the labels of the blocks it jumps to
+ */
+struct JumpTable {
+    Name label;
+    std::vector<Name> targets;
+};
+
+/**
+ * The instructions of one function, in layout order, and the jump tables it uses
+ */
+struct Function {
+    std::string_view name;
+    std::vector<Block> blocks;
+    std::vector<JumpTable> tables;
+    // The bytes of the stack frame, the code that makes and removes the frame moves $sp by this much
+    int frame_size = 0;
+
+    void append(const Instruction &instruction);
+    void place(Name label);
+};
+
+/**
+ * The control flow between the blocks of a function
+ */
+class Graph {
+public:
+    explicit Graph(const Function &function);
+    std::size_t find(const Name &target) const;
+    static constexpr std::size_t none = -1;
+
+    // The blocks that follow a block, there are at most two unless it jumps through a table
+    struct Successors {
+        std::array<std::size_t, 2> blocks;
+        std::size_t count = 0;
+        std::vector<std::size_t> table;
+
+        void add(std::size_t block) { blocks[count++] = block; }
+        const std::size_t *begin() const { return table.empty() ? blocks.data() : table.data(); }
+        const std::size_t *end() const { return table.empty() ? blocks.data() + count : table.data() + table.size(); }
+    };
+
+    const Successors &successors(std::size_t block) const;
+
+private:
+    const Function &function;
+    std::unordered_map<int, std::size_t> labels;
+    std::size_t epilogue = none;
+    std::vector<Successors> edges;
+
+    Successors find_successors(std::size_t block) const;
+};
+
+void print(const Instruction &instruction, AsmWriter &writer);
+void print(const Function &function, AsmWriter &writer);
@@ -1,13 +1,43 @@
 #include <sstream>
 #include "parser.h"
 #include "logger.h"
+#include "universe.h"
 
 /**
  * Parser class constructor
+ * Tokens are pulled from the lexer as the parser advances, only the current and previous tokens are kept
  * @param filereader pointer to a FileReader object
- * @param tokens list of tokens to parse
+ * @param lexer the lexer to pull tokens from
+ * @param tree the tree to add the parsed nodes to
  */
-Parser::Parser(Input *input, std::vector<Token> tokens) : input(input), tokens(tokens) {}
+Parser::Parser(Input *input, Lexer &lexer, Tree &tree) : input(input), lexer(lexer), tree(tree),
+                                                         previous_token(Eof, "", 0, 0),
+                                                         current_token(lexer.next_token()) {}
+
+/**
+ * Counts the levels of the tree the parser descends into while it lives, and restores the depth when it is destroyed
+ */
+class Parser::Nesting {
+public:
+    explicit Nesting(Parser &parser) : parser(parser), outer(parser.depth) {}
+    Nesting(const Nesting &) = delete;
+    Nesting &operator=(const Nesting &) = delete;
+    ~Nesting() { parser.depth = outer; }
+
+    /**
+     * Descends one level, reporting an error once the program is nested deeper than the limit
+     * @param token the token that opens the level
+     */
+    void deeper(const Token &token) {
+        if (++parser.depth > max_depth)
+            Logger::error(parser.input, token.line, token.column, token.lexeme.length(),
+                          "nested more than " + std::to_string(max_depth) + " levels deep");
+    }
+
+private:
+    Parser &parser;
+    std::uint32_t outer;
+};
 
 /**
  * Check if parser has reached the final token
@@ -21,9 +51,11 @@ bool Parser::is_at_end() {
  * Advance the parser to the next token
  * @return the next token
  */
-Token Parser::advance() {
-    if (!is_at_end())
-        current++;
+const Token &Parser::advance() {
+    if (!is_at_end()) {
+        previous_token = current_token;
+        current_token = lexer.next_token();
+    }
     return peek();
 }
 
@@ -31,16 +63,16 @@ Token Parser::advance() {
  * Returns the next token without advancing the current position
  * @return the next token
  */
-Token Parser::peek() {
-    return tokens.at(current);
+const Token &Parser::peek() {
+    return current_token;
 }
 
 /**
  * Returns the previous token without reducing the current position
  * @return the previous token
  */
-Token Parser::previous() {
-    return tokens.at(current - 1);
+const Token &Parser::previous() {
+    return previous_token;
 }
 
 /**
@@ -50,7 +82,6 @@ Token Parser::previous() {
  * @return the consumed token
  */
 Token Parser::consume(TokenType type) {
-    auto curr = peek();
     std::stringstream ss;
     ss << "expected " << type << ", got " << peek().type;
     return consume(type, ss.str());
@@ -99,6 +130,31 @@ bool Parser::match(TokenType expected) {
     return true;
 }
 
+/**
+ * Maps a binary operator token to the kind of node it produces
+ * @param type the operator token type
+ * @return the binary node kind
+ */
+NodeKind Parser::binary_kind(TokenType type) {
+    switch (type) {
+        case Equal: return NodeKind::Assign;
+        case Or: return NodeKind::Or;
+        case And: return NodeKind::And;
+        case EqualEqual: return NodeKind::Equal;
+        case NotEqual: return NodeKind::NotEqual;
+        case Less: return NodeKind::Less;
+        case LessEqual: return NodeKind::LessEqual;
+        case Greater: return NodeKind::Greater;
+        case GreaterEqual: return NodeKind::GreaterEqual;
+        case Add: return NodeKind::Add;
+        case Subtract: return NodeKind::Subtract;
+        case Multiply: return NodeKind::Multiply;
+        case Divide: return NodeKind::Divide;
+        case Modulo: return NodeKind::Modulo;
+        default: throw std::invalid_argument("not a binary operator");
+    }
+}
+
 /**
  * Program ::= { Declaration } EOF
  *
@@ -106,22 +162,23 @@ bool Parser::match(TokenType expected) {
  * @param verbose should the abstract syntax tree be printed
  * @return abstract syntax tree (AST) representing the given list of tokens
  */
-AST *Parser::parse(bool verbose) {
-    auto ast = new AST("program");
+AST Parser::parse(bool verbose) {
+    std::vector<AST> children;
     while (!is_at_end()) {
         auto child = decl();
-        ast->add_child(child);
+        children.push_back(child);
     }
+    auto ast = tree.add(NodeKind::Program, "", -1, -1, children);
     if (verbose)
-        ast->print();
+        ast.print();
     return ast;
 }
 
 /**
  * Declaration ::= VarDecl | FuncDecl ";"
  */
-AST *Parser::decl() {
-    AST *ast;
+AST Parser::decl() {
+    AST ast;
 
     switch (peek().type) {
         case Var:ast = var_decl(true);
@@ -140,62 +197,54 @@ AST *Parser::decl() {
 /**
  * VarDecl ::= "var" identifier identifier
  */
-AST *Parser::var_decl(bool global) {
+AST Parser::var_decl(bool global) {
     auto token = consume(Var);
-    auto ast = new AST(global ? "globalvar" : "var", token.line, token.column);
 
     // Variable name
     auto id = consume(Identifier, "variable identifier must follow the \"var\" keyword");
-    ast->add_child(new AST("newid", id.lexeme, id.line, id.column));
+    auto name = tree.add(NodeKind::NewId, id.lexeme, id.symbol, id.line, id.column);
 
     // Variable type
     auto type = consume(Identifier, "variable type must follow the identifier");
-    ast->add_child(new AST("typeid", type.lexeme, type.line, type.column));
+    auto type_name = tree.add(NodeKind::TypeId, type.lexeme, type.symbol, type.line, type.column);
 
-    return ast;
+    return tree.add(global ? NodeKind::GlobalVar : NodeKind::Var, token.line, token.column, {name, type_name});
 }
 
 /**
  * FuncDecl ::= "func" identifier Signature Block
  */
-AST *Parser::func_decl() {
+AST Parser::func_decl() {
     auto token = consume(Func);
-    auto ast = new AST("func", token.line, token.column);
 
     // Function name
     auto id = consume(Identifier, "function identifier must follow the \"func\" keyword");
-    ast->add_child(new AST("newid", id.lexeme, id.line, id.column));
+    auto name = tree.add(NodeKind::NewId, id.lexeme, id.symbol, id.line, id.column);
 
     // Function signature
     auto signature = func_sig();
-    ast->add_child(signature);
 
     // Function body
     auto body = block();
-    ast->add_child(body);
 
-    return ast;
+    return tree.add(NodeKind::Func, token.line, token.column, {name, signature, body});
 }
 
 /**
  * Signature ::= "(" { identifier identifier "," } ")" [ identifier ]
  */
-AST *Parser::func_sig() {
-    auto ast = new AST("sig");
-
+AST Parser::func_sig() {
     // Opening paren
     consume(LeftParen, "function signature must open with \"(\"");
 
     // Formals
-    auto formals = new AST("formals");
-    ast->add_child(formals);
+    std::vector<AST> formals;
     while (check(Identifier)) {
-        auto formal = new AST("formal");
         auto id = consume(Identifier, "signature formal must begin with an identifier");
-        formal->add_child(new AST("newid", id.lexeme, id.line, id.column));
+        auto name = tree.add(NodeKind::NewId, id.lexeme, id.symbol, id.line, id.column);
         auto type = consume(Identifier, "expected a type to follow the formal identifier");
-        formal->add_child(new AST("typeid", type.lexeme, type.line, type.column));
-        formals->add_child(formal);
+        auto type_name = tree.add(NodeKind::TypeId, type.lexeme, type.symbol, type.line, type.column);
+        formals.push_back(tree.add(NodeKind::Formal, {name, type_name}));
 
         if (!match(Comma))
             break;
@@ -205,32 +254,35 @@ AST *Parser::func_sig() {
     consume(RightParen, "function signature must be closed with \")\"");
 
     // Optional return type
+    AST return_type;
     auto has_type = check(Identifier);
     if (has_type) {
         auto type = consume(Identifier);
-        ast->add_child(new AST("typeid", type.lexeme, type.line, type.column));
+        return_type = tree.add(NodeKind::TypeId, type.lexeme, type.symbol, type.line, type.column);
     } else {
-        ast->add_child(new AST("typeid", "$void"));
+        return_type = tree.add(NodeKind::TypeId, "$void", universe_id("$void"), -1, -1);
     }
 
-    return ast;
+    return tree.add(NodeKind::Sig, {tree.add(NodeKind::Formals, "", -1, -1, formals), return_type});
 }
 
 /**
  * Block ::= "{" { Statement } "}"
  */
-AST *Parser::block() {
-    auto ast = new AST("block");
+AST Parser::block() {
+    Nesting nesting(*this);
+    nesting.deeper(peek());
     consume(LeftBracket, "block must begin with \"{\"");
 
     // Block body
+    std::vector<AST> children;
     while (!check(RightBracket)) {
         auto child = stmt();
-        ast->add_child(child);
+        children.push_back(child);
     }
 
     consume(RightBracket, "block must close with \"}\"");
-    return ast;
+    return tree.add(NodeKind::Block, "", -1, -1, children);
 }
 
 /**
@@ -244,8 +296,8 @@ AST *Parser::block() {
  *  | ExpressionStmt
  *  ";"
  */
-AST *Parser::stmt() {
-    AST *ast;
+AST Parser::stmt() {
+    AST ast;
 
     switch (peek().type) {
         case Var:ast = var_decl(false);
@@ -271,83 +323,77 @@ AST *Parser::stmt() {
 /**
  * IfStmt ::= "if" Expression block [ "else" IfStmt | block ]
  */
-AST *Parser::if_stmt() {
+AST Parser::if_stmt() {
     auto token = consume(If);
-    auto ast = new AST("if", token.line, token.column);
+    Nesting nesting(*this);
+    nesting.deeper(token);
 
     // Condition
     auto condition = expr();
-    ast->add_child(condition);
 
     // If body
     auto body = block();
-    ast->add_child(body);
 
     // Optional else/else-if
     if (match(Else)) {
         // Else-if
         if (check(If))
-            ast->add_child(if_stmt());
+            return tree.add(NodeKind::If, token.line, token.column, {condition, body, if_stmt()});
             // Else
         else
-            ast->add_child((new AST("else"))->add_child(block()));
+            return tree.add(NodeKind::If, token.line, token.column, {condition, body, tree.add(NodeKind::Else, {block()})});
     }
 
-    return ast;
+    return tree.add(NodeKind::If, token.line, token.column, {condition, body});
 }
 
 /**
  * ForStmt ::= "for" Expression block
  */
-AST *Parser::for_stmt() {
+AST Parser::for_stmt() {
     auto token = consume(For);
-    auto ast = new AST("for", token.line, token.column);
 
     // Optional condition
-    AST *condition;
+    AST condition;
     if (check(LeftBracket)) {
-        condition = new AST("id", "$true");
+        condition = tree.add(NodeKind::Id, "$true", universe_id("$true"), -1, -1);
     } else {
         condition = expr();
     }
-    ast->add_child(condition);
 
     // For body
     auto body = block();
-    ast->add_child(body);
 
-    return ast;
+    return tree.add(NodeKind::For, token.line, token.column, {condition, body});
 }
 
 /**
  * BreakStmt ::= "break"
  */
-AST *Parser::break_stmt() {
+AST Parser::break_stmt() {
     auto token = consume(Break);
-    auto ast = new AST("break", token.line, token.column);
-    return ast;
+    return tree.add(NodeKind::Break, token.line, token.column);
 }
 
 /**
  * ReturnStmt ::= "return" [ Expression ]
  */
-AST *Parser::return_stmt() {
+AST Parser::return_stmt() {
     auto token = consume(Return);
-    auto ast = new AST("return", token.line, token.column);
 
     // Optional return expression
     if (!check(Semicolon)) {
         auto child = expr();
-        ast->add_child(child);
+        return tree.add(NodeKind::Return, token.line, token.column, {child});
     }
 
-    return ast;
+    return tree.add(NodeKind::Return, token.line, token.column);
 }
 
 /**
  * ExpressionStmt ::= Assignment
  */
-AST *Parser::expr_stmt() {
+AST Parser::expr_stmt() {
     auto ast = assignment();
     return ast;
 }
@@ -355,13 +401,13 @@ AST *Parser::expr_stmt() {
 /**
  * Assignment ::= Expr "=" Expr | Expr
  */
-AST *Parser::assignment() {
+AST Parser::assignment() {
     auto l = expr();
 
     if (match(Equal)) {
         auto op = previous();
         auto r = expr();
-        l = (new AST(op.lexeme, op.line, op.column))->add_child(l)->add_child(r);
+        l = tree.add(binary_kind(op.type), op.line, op.column, {l, r});
     }
 
     return l;
@@ -370,7 +416,7 @@ AST *Parser::assignment() {
 /**
  * Expression ::= OrExpr
  */
-AST *Parser::expr() {
+AST Parser::expr() {
     auto ast = or_expr();
     return ast;
 }
@@ -378,13 +424,15 @@ AST *Parser::expr() {
 /**
  * OrExpr ::= AndExpr { "||" AndExpr }
  */
-AST *Parser::or_expr() {
+AST Parser::or_expr() {
+    Nesting nesting(*this);
     auto l = and_expr();
 
     while (match(Or)) {
         auto op = previous();
+        nesting.deeper(op);
         auto r = and_expr();
-        l = (new AST(op.lexeme, op.line, op.column))->add_child(l)->add_child(r);
+        l = tree.add(binary_kind(op.type), op.line, op.column, {l, r});
     }
 
     return l;
@@ -393,13 +441,15 @@ AST *Parser::or_expr() {
 /**
  * AndExpr ::= RelExpr { "&&" RelExpr }
  */
-AST *Parser::and_expr() {
+AST Parser::and_expr() {
+    Nesting nesting(*this);
     auto l = rel_expr();
 
     while (match(And)) {
         auto op = previous();
+        nesting.deeper(op);
         auto r = rel_expr();
-        l = (new AST(op.lexeme, op.line, op.column))->add_child(l)->add_child(r);
+        l = tree.add(binary_kind(op.type), op.line, op.column, {l, r});
     }
 
     return l;
@@ -408,14 +458,16 @@ AST *Parser::and_expr() {
 /**
  * RelExpr ::= AddExpr { ("==" | "!=" | "<" | "<=" | ">" | ">=") AddExpr }
  */
-AST *Parser::rel_expr() {
+AST Parser::rel_expr() {
+    Nesting nesting(*this);
     auto l = add_expr();
 
     while (match(EqualEqual) || match(NotEqual) || match(Less) ||
            match(LessEqual) || match(Greater) || match(GreaterEqual)) {
         auto op = previous();
+        nesting.deeper(op);
         auto r = add_expr();
-        l = (new AST(op.lexeme, op.line, op.column))->add_child(l)->add_child(r);
+        l = tree.add(binary_kind(op.type), op.line, op.column, {l, r});
     }
 
     return l;
@@ -424,13 +476,15 @@ AST *Parser::rel_expr() {
 /**
  * AddExpr ::= MulExpr { ("+" | "-") MulExpr }
  */
-AST *Parser::add_expr() {
+AST Parser::add_expr() {
+    Nesting nesting(*this);
     auto l = mul_expr();
 
     while (match(Add) || match(Subtract)) {
         auto op = previous();
+        nesting.deeper(op);
         auto r = mul_expr();
-        l = (new AST(op.lexeme, op.line, op.column))->add_child(l)->add_child(r);
+        l = tree.add(binary_kind(op.type), op.line, op.column, {l, r});
     }
 
     return l;
@@ -439,13 +493,15 @@ AST *Parser::add_expr() {
 /**
  * MulExpr ::= UnaryExpr { ("*" | "/" | "%") UnaryExpr }
  */
-AST *Parser::mul_expr() {
+AST Parser::mul_expr() {
+    Nesting nesting(*this);
     auto l = unary_expr();
 
     while (match(Multiply) || match(Divide) || match(Modulo)) {
         auto op = previous();
+        nesting.deeper(op);
         auto r = unary_expr();
-        l = (new AST(op.lexeme, op.line, op.column))->add_child(l)->add_child(r);
+        l = tree.add(binary_kind(op.type), op.line, op.column, {l, r});
     }
 
     return l;
@@ -454,20 +510,23 @@ AST *Parser::mul_expr() {
 /**
  * UnaryExpr ::= ("!" | "-") UnaryExpr | FuncCall
  */
-AST *Parser::unary_expr() {
+AST Parser::unary_expr() {
     // TODO: Refactor this to be more concise if you are out of fun things to do in life :)
+    Nesting nesting(*this);
     if (match(Not)) {
         auto op = previous();
+        nesting.deeper(op);
         auto r = unary_expr();
-        return (new AST(op.lexeme, op.line, op.column))->add_child(r);
+        return tree.add(NodeKind::Not, op.line, op.column, {r});
     }
     if (match(Subtract)) {
         // TODO: Hacky solution for negative integers
         if(match(Integer))
-            return new AST("int", "-" + previous().lexeme, previous().line, previous().column - 1);
+            return tree.add(NodeKind::Int, tree.intern("-" + std::string(previous().lexeme)), previous().line, previous().column - 1);
         auto op = previous();
+        nesting.deeper(op);
         auto r = unary_expr();
-        return (new AST("u" + op.lexeme, op.line, op.column))->add_child(r);
+        return tree.add(NodeKind::Negate, op.line, op.column, {r});
     }
 
     return func_call();
@@ -476,21 +535,23 @@ AST *Parser::unary_expr() {
 /**
  * FuncCall ::= Operand | Operand "(" [ Expression { "," Expression } ] ")"
  */
-AST *Parser::func_call() {
+AST Parser::func_call() {
+    Nesting nesting(*this);
     auto ast = operand();
 
     // Arguments
     while (match(LeftParen)) {
-        ast = (new AST("funccall", previous().line, previous().column))->add_child(ast);
-        auto actuals = new AST("actuals");
-        ast->add_child(actuals);
+        auto paren = previous();
+        nesting.deeper(paren);
+        std::vector<AST> actuals;
         while (!match(RightParen)) {
-            actuals->add_child(expr());
+            actuals.push_back(expr());
             if (!match(Comma)) {
                 consume(RightParen, "function call must closed with \")\"");
                 break;
             }
         }
+        ast = tree.add(NodeKind::FuncCall, paren.line, paren.column, {ast, tree.add(NodeKind::Actuals, "", -1, -1, actuals)});
     }
 
     return ast;
@@ -499,20 +560,22 @@ AST *Parser::func_call() {
 /**
  * Operand ::= int_lit | string_lit | identifier | ";" | "(" Expression ")"
  */
-AST *Parser::operand() {
+AST Parser::operand() {
     if (match(Integer))
-        return new AST("int", previous().lexeme, previous().line, previous().column);
+        return tree.add(NodeKind::Int, previous().lexeme, previous().line, previous().column);
 
     if (match(String))
-        return new AST("string", previous().lexeme, previous().line, previous().column);
+        return tree.add(NodeKind::String, previous().lexeme, previous().line, previous().column);
 
     if (match(Identifier))
-        return new AST("id", previous().lexeme, previous().line, previous().column);
+        return tree.add(NodeKind::Id, previous().lexeme, previous().symbol, previous().line, previous().column);
 
     if (check(Semicolon))
-        return new AST("emptystmt");
+        return tree.add(NodeKind::EmptyStmt);
 
     if (match(LeftParen)) {
+        Nesting nesting(*this);
+        nesting.deeper(previous());
         auto ast = expr();
         consume(RightParen, "parenthesised operands must be closed with \")\"");
         return ast;
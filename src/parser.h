@@ -2,6 +2,7 @@
 
 #include "ast.h"
 #include "token.h"
+#include "lexer.h"
 #include "file_input.h"
 #include "input.h"
 #include <vector>
@@ -10,41 +11,51 @@
 
 class Parser {
 public:
-    Parser(Input *input, std::vector<Token> tokens);
-    AST* parse(bool verbose);
+    Parser(Input *input, Lexer &lexer, Tree &tree);
+    AST parse(bool verbose);
 
 private:
-    int current = 0;
+    class Nesting;
+
+    // Every pass over the tree recurses once per level, so deeper programs are rejected before they can overflow the stack
+    static constexpr std::uint32_t max_depth = 500;
+
     Input *input;
-    std::vector<Token> tokens;
+    Lexer &lexer;
+    Tree &tree;
+    Token previous_token;
+    Token current_token;
+    // The levels of the tree the parser is inside of
+    std::uint32_t depth = 0;
 
     bool is_at_end();
-    Token advance();
-    Token peek();
-    Token previous();
+    const Token &advance();
+    const Token &peek();
+    const Token &previous();
     Token consume(TokenType type);
     Token consume(TokenType type, const std::string &error_message);
     bool check(TokenType type);
     bool match(TokenType expected);
-    AST* decl();
-    AST* var_decl(bool global);
-    AST* func_decl();
-    AST* func_sig();
-    AST* block();
-    AST* stmt();
-    AST* if_stmt();
-    AST* for_stmt();
-    AST* break_stmt();
-    AST* return_stmt();
-    AST* expr_stmt();
-    AST* expr();
-    AST *assignment();
-    AST *or_expr();
-    AST *and_expr();
-    AST *rel_expr();
-    AST *add_expr();
-    AST *mul_expr();
-    AST *unary_expr();
-    AST *func_call();
-    AST *operand();
+    static NodeKind binary_kind(TokenType type);
+    AST decl();
+    AST var_decl(bool global);
+    AST func_decl();
+    AST func_sig();
+    AST block();
+    AST stmt();
+    AST if_stmt();
+    AST for_stmt();
+    AST break_stmt();
+    AST return_stmt();
+    AST expr_stmt();
+    AST expr();
+    AST assignment();
+    AST or_expr();
+    AST and_expr();
+    AST rel_expr();
+    AST add_expr();
+    AST mul_expr();
+    AST unary_expr();
+    AST func_call();
+    AST operand();
 };
@@ -0,0 +1,439 @@
+#include <algorithm>
+#include <array>
+#include <utility>
+#include <vector>
+
+#include "peephole.h"
+
+namespace {
+
+// How far back a move looks for the instruction that computed its source
+constexpr int coalesce_window = 16;
+
+// How many times the passes are repeated, each round exposes less to the next
+constexpr int max_rounds = 8;
+
+constexpr std::size_t index(Reg reg) {
+    return static_cast<std::size_t>(reg);
+}
+
+/**
+ * Gets whether a loaded literal is zero
+ * @param instruction an `li` instruction
+ * @return 1 if the value is nonzero, 0 if it is zero, or -1 if it is not known
+ */
+int truth(const Instruction &instruction) {
+    if (instruction.name.kind == NameKind::None)
+        return instruction.imm != 0;
+    auto text = instruction.name.text;
+    if (text == "Ltrue")
+        return 1;
+    if (text == "Lfalse")
+        return 0;
+    if (text.empty() || text.find_first_not_of("0123456789") != std::string_view::npos)
+        return -1;
+    return text.find_first_not_of('0') != std::string_view::npos;
+}
+
+/**
+ * @return whether the memory operand of a load or store names a single known word
+ * Only globals that are not indexed by a register, and stack slots, qualify
+ */
+bool is_known(const Instruction &instruction) {
+    return (instruction.name.kind != NameKind::None && instruction.rs == Reg::None) || instruction.rs == Reg::Sp;
+}
+
+bool same_address(const Instruction &a, const Instruction &b) {
+    return a.name == b.name && a.rs == b.rs && (a.name.kind != NameKind::None || a.imm == b.imm);
+}
+
+/**
+ * Forwards values within a block, and on into the blocks that can only be entered by falling through from it
+ * Registers that are copies of other registers are replaced by the originals, and loads of a word that is
+ * already in a register become moves, so the copies and loads are left dead
+ * Literals are not reused the same way, a move costs as much as loading the literal again
+ * Branches on registers that hold a known literal are decided
+ */
+class Forwarding {
+public:
+    bool run(Block &block, bool falls_through);
+
+private:
+    // The register each register is a copy of, or `None`
+    std::array<Reg, 256> copy_of;
+    std::vector<Reg> copies;
+
+    // Whether each register is zero, see `truth`
+    std::array<signed char, 256> truths;
+
+    // The register holding each known word of memory, keyed by the load or store that put it there
+    std::vector<std::pair<Instruction, Reg>> memory;
+
+    void reset();
+    void kill(Reg reg);
+    Reg root(Reg reg) const;
+    Reg holder(const Instruction &instruction) const;
+};
+
+void Forwarding::reset() {
+    copy_of.fill(Reg::None);
+    copies.clear();
+    truths.fill(-1);
+    truths[index(Reg::Zero)] = 0;
+    memory.clear();
+}
+
+/**
+ * Forgets everything that depends on the value of a register, as it is about to be written
+ * @param reg the register
+ */
+void Forwarding::kill(Reg reg) {
+    copy_of[index(reg)] = Reg::None;
+    copies.erase(std::remove_if(copies.begin(), copies.end(), [&](Reg copy) {
+        if (copy_of[index(copy)] == reg)
+            copy_of[index(copy)] = Reg::None;
+        return copy_of[index(copy)] == Reg::None;
+    }), copies.end());
+    if (reg != Reg::Zero)
+        truths[index(reg)] = -1;
+    memory.erase(std::remove_if(memory.begin(), memory.end(), [&](const auto &word) {
+        return word.second == reg;
+    }), memory.end());
+}
+
+Reg Forwarding::root(Reg reg) const {
+    auto original = copy_of[index(reg)];
+    return original == Reg::None ? reg : original;
+}
+
+/**
+ * Finds a register that already holds the word a load reads
+ * @param instruction the instruction
+ * @return the register, or `None` if the instruction is not a load of a known word or the word is not in a register
+ */
+Reg Forwarding::holder(const Instruction &instruction) const {
+    if (instruction.op != Opcode::Lw || !is_known(instruction))
+        return Reg::None;
+    for (auto &[loaded, reg]: memory)
+        if (same_address(loaded, instruction))
+            return reg;
+    return Reg::None;
+}
+
+/**
+ * @param block the block to rewrite
+ * @param falls_through whether the block is only entered from the end of the block that was run before it
+ * @return whether anything changed
+ */
+bool Forwarding::run(Block &block, bool falls_through) {
+    if (!falls_through)
+        reset();
+    auto changed = false;
+    std::vector<Instruction> instructions;
+    instructions.reserve(block.instructions.size());
+    for (auto instruction: block.instructions) {
+        if (instruction.op != Opcode::Jr) {
+            auto rs = root(instruction.rs);
+            auto rt = root(instruction.rt);
+            changed |= rs != instruction.rs || rt != instruction.rt;
+            instruction.rs = rs;
+            instruction.rt = rt;
+        }
+
+        // A word that is already in a register is copied from there instead
+        auto held = holder(instruction);
+        if (held != Reg::None) {
+            changed = true;
+            if (held == instruction.rd)
+                continue;
+            instruction = Instruction::rr(Opcode::Move, instruction.rd, held);
+        }
+
+        // Adding or subtracting 0 in place, which saving no registers around a call does
+        if ((instruction.op == Opcode::Addu || instruction.op == Opcode::Subu) && instruction.rt == Reg::None &&
+            instruction.imm == 0 && instruction.rd == instruction.rs) {
+            changed = true;
+            continue;
+        }
+
+        switch (instruction.op) {
+            case Opcode::Beqz:
+            case Opcode::Bnez: {
+                auto value = truths[index(instruction.rs)];
+                if (value < 0)
+                    break;
+                changed = true;
+                if ((instruction.op == Opcode::Beqz) != (value == 0))
+                    continue;
+                instruction = Instruction::jump(Opcode::J, instruction.name);
+                break;
+            }
+            case Opcode::Li:
+            case Opcode::La:
+                kill(instruction.rd);
+                truths[index(instruction.rd)] = instruction.op == Opcode::Li ? truth(instruction) : 1;
+                break;
+            case Opcode::Lw:
+                kill(instruction.rd);
+                if (is_known(instruction))
+                    memory.emplace_back(instruction, instruction.rd);
+                break;
+            case Opcode::Move: {
+                auto rd = instruction.rd, rs = instruction.rs;
+                if (rd == rs) {
+                    changed = true;
+                    continue;
+                }
+                kill(rd);
+                copy_of[index(rd)] = rs;
+                copies.push_back(rd);
+                truths[index(rd)] = truths[index(rs)];
+                break;
+            }
+            case Opcode::Sw: {
+                if (!is_known(instruction)) {
+                    memory.clear();
+                    break;
+                }
+                // Storing the value the word already holds changes nothing
+                if (holder(Instruction::load(instruction.rt, {instruction.name, instruction.rs, instruction.imm})) ==
+                    instruction.rt) {
+                    changed = true;
+                    continue;
+                }
+                memory.erase(std::remove_if(memory.begin(), memory.end(), [&](const auto &word) {
+                    return same_address(word.first, instruction);
+                }), memory.end());
+                memory.emplace_back(instruction, instruction.rt);
+                break;
+            }
+            case Opcode::Jal:
+                reset();
+                break;
+            default:
+                if (instruction.is_terminator())
+                    break;
+                kill(instruction.rd);
+                if (instruction.rd == Reg::Sp)
+                    memory.clear();
+                break;
+        }
+        instructions.push_back(instruction);
+    }
+    block.instructions = std::move(instructions);
+    return changed;
+}
+
+/**
+ * Computes the registers that are live at the end of each block
+ * @param function the function
+ * @param graph the control flow of the function
+ * @return the live registers, indexed by block
+ */
+std::vector<RegSet> live_out(const Function &function, const Graph &graph) {
+    auto count = function.blocks.size();
+    std::vector<RegSet> uses(count), defs(count), in(count), out(count);
+    for (std::size_t i = 0; i < count; i++) {
+        auto &instructions = function.blocks[i].instructions;
+        for (auto instruction = instructions.rbegin(); instruction != instructions.rend(); ++instruction) {
+            auto written = instruction->defs();
+            uses[i] = (uses[i] & ~written) | instruction->uses();
+            defs[i] |= written;
+        }
+    }
+
+    auto changed = true;
+    while (changed) {
+        changed = false;
+        for (auto i = count; i-- > 0;) {
+            RegSet live;
+            for (auto successor: graph.successors(i))
+                live |= successor == Graph::none ? RegSet().set() : in[successor];
+            out[i] = live;
+            live = uses[i] | (live & ~defs[i]);
+            if (live != in[i]) {
+                in[i] = live;
+                changed = true;
+            }
+        }
+    }
+    return out;
+}
+
+/**
+ * Removes instructions whose results are never read, and computes the sources of moves straight into their
+ * destinations when the source is not read again
+ * @param block the block to rewrite
+ * @param live the registers live at the end of the block
+ * @return whether anything changed
+ */
+bool sweep(Block &block, RegSet live) {
+    auto &instructions = block.instructions;
+    std::vector<bool> removed(instructions.size());
+    auto changed = false;
+    for (auto j = static_cast<int>(instructions.size()) - 1; j >= 0; j--) {
+        auto &instruction = instructions[j];
+        auto rd = instruction.rd;
+        if (instruction.is_pure() && !live.test(index(rd))) {
+            removed[j] = changed = true;
+            continue;
+        }
+
+        if (instruction.op == Opcode::Move && !live.test(index(instruction.rs)) && rd != Reg::Sp) {
+            auto rs = instruction.rs;
+            for (auto i = j - 1; i >= 0 && i >= j - coalesce_window; i--) {
+                if (removed[i])
+                    continue;
+                auto &source = instructions[i];
+                if (source.clobbers().test(index(rs))) {
+                    if (source.is_pure() || source.op == Opcode::Div || source.op == Opcode::Rem) {
+                        source.rd = rd;
+                        removed[j] = changed = true;
+                    }
+                    break;
+                }
+                if (source.uses().test(index(rs)) || source.uses().test(index(rd)) ||
+                    source.clobbers().test(index(rd)))
+                    break;
+            }
+            if (removed[j])
+                continue;
+        }
+
+        live = (live & ~instruction.defs()) | instruction.uses();
+    }
+
+    if (changed) {
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < instructions.size(); i++)
+            if (!removed[i])
+                instructions[kept++] = instructions[i];
+        instructions.resize(kept);
+    }
+    return changed;
+}
+
+/**
+ * Removes the blocks that cannot be reached from the start of the function, such as the statements after a
+ * `return` or `break` and the branches of decided conditions, along with the jump tables of removed dispatches
+ * @return whether anything changed
+ */
+bool remove_unreachable(Function &function, const Graph &graph) {
+    std::vector<bool> reached(function.blocks.size());
+    std::vector<std::size_t> pending = {0};
+    while (!pending.empty()) {
+        auto block = pending.back();
+        pending.pop_back();
+        if (block == Graph::none || reached[block])
+            continue;
+        reached[block] = true;
+        for (auto successor: graph.successors(block))
+            pending.push_back(successor);
+    }
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < function.blocks.size(); i++)
+        if (reached[i] && kept++ != i)
+            function.blocks[kept - 1] = std::move(function.blocks[i]);
+    auto changed = kept != function.blocks.size();
+    function.blocks.resize(kept);
+
+    // The tables of the dispatches that were removed go too, and the remaining ones are renumbered
+    std::vector<JumpTable> tables;
+    for (auto &block: function.blocks) {
+        if (block.instructions.empty() || block.instructions.back().op != Opcode::Jtab)
+            continue;
+        auto &last = block.instructions.back();
+        tables.push_back(std::move(function.tables[last.imm]));
+        last.imm = static_cast<int>(tables.size()) - 1;
+    }
+    function.tables = std::move(tables);
+    return changed;
+}
+
+/**
+ * Points jumps and branches that land on a jump at its target instead, and returns in place of jumps to a return
+ * @return whether anything changed
+ */
+bool thread_jumps(Function &function, const Graph &graph) {
+    auto changed = false;
+    for (auto &block: function.blocks) {
+        if (block.instructions.empty())
+            continue;
+        auto &last = block.instructions.back();
+        if (last.op != Opcode::J && last.op != Opcode::Beqz && last.op != Opcode::Bnez)
+            continue;
+        for (int hops = 0; hops < max_rounds; hops++) {
+            auto target = graph.find(last.name);
+            if (target == Graph::none)
+                break;
+            auto &instructions = function.blocks[target].instructions;
+            // A jump to a return returns in place
+            if (last.op == Opcode::J && !instructions.empty() && instructions.front().op == Opcode::Jr) {
+                last = instructions.front();
+                changed = true;
+                break;
+            }
+            if (instructions.empty() || instructions.front().op != Opcode::J ||
+                graph.find(instructions.front().name) == Graph::none || instructions.front().name == last.name)
+                break;
+            last.name = instructions.front().name;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+/**
+ * Removes jumps and branches to the block that follows anyway
+ * @return whether anything changed
+ */
+bool remove_fallthrough_jumps(Function &function) {
+    auto changed = false;
+    auto &blocks = function.blocks;
+    for (std::size_t i = 0; i < blocks.size(); i++) {
+        auto &instructions = blocks[i].instructions;
+        if (instructions.empty())
+            continue;
+        auto &last = instructions.back();
+        if (last.op != Opcode::J && last.op != Opcode::Beqz && last.op != Opcode::Bnez)
+            continue;
+        for (auto next = i + 1; next < blocks.size(); next++) {
+            if (blocks[next].label == last.name) {
+                instructions.pop_back();
+                changed = true;
+                break;
+            }
+            if (!blocks[next].instructions.empty())
+                break;
+        }
+    }
+    return changed;
+}
+
+}
+
+/**
+ * Rewrites the instructions of a function into fewer, equivalent ones (-O1)
+ * The function keeps the registers and stack frame it was given, and only $v0 is assumed to be read once it returns
+ * @param function the function to rewrite
+ */
+void peephole(Function &function) {
+    Forwarding forwarding;
+    for (int round = 0; round < max_rounds; round++) {
+        auto changed = false;
+        for (std::size_t i = 0; i < function.blocks.size(); i++)
+            changed |= forwarding.run(function.blocks[i], i > 0 && function.blocks[i].label.kind == NameKind::None);
+
+        changed |= thread_jumps(function, Graph(function));
+        changed |= remove_unreachable(function, Graph(function));
+        changed |= remove_fallthrough_jumps(function);
+
+        Graph graph(function);
+        auto live = live_out(function, graph);
+        for (std::size_t i = 0; i < function.blocks.size(); i++)
+            changed |= sweep(function.blocks[i], live[i]);
+
+        if (!changed)
+            break;
+    }
+}
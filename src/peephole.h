@@ -0,0 +1,5 @@
+#pragma once
+
+#include "mir.h"
+
+void peephole(Function &function);
@@ -2,9 +2,11 @@
 
 #include <string>
 
+#include "type.h"
+
 struct Record {
-	std::string sig;
-	std::string rt_sig;
+	const Type *sig = nullptr;
+	const Type *rt_sig = nullptr;
 	bool is_const;
 	bool is_type;
 
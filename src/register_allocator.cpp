@@ -0,0 +1,403 @@
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <deque>
+#include <vector>
+
+#include "register_allocator.h"
+
+namespace {
+
+// The registers that are handed out, calls may overwrite the $t registers but not the $s registers
+constexpr std::array<Reg, 19> allocatable = {
+        Reg::T0, Reg::T1, Reg::T2, Reg::T3, Reg::T4, Reg::T5, Reg::T6, Reg::T7, Reg::T8, Reg::T9,
+        Reg::S0, Reg::S1, Reg::S2, Reg::S3, Reg::S4, Reg::S5, Reg::S6, Reg::S7, Reg::S8,
+};
+
+std::size_t number(Reg reg) {
+    return static_cast<std::uint32_t>(reg) - first_virtual;
+}
+
+/**
+ * @return whether the instruction writes its `rd`, the other registers it names are only read
+ */
+bool writes(const Instruction &instruction) {
+    return instruction.op != Opcode::Sw && !instruction.is_terminator();
+}
+
+/**
+ * A set of virtual registers, by number in increasing order
+ * Most values live within a single block, so the sets of the values live between blocks are small
+ */
+using Registers = std::vector<std::size_t>;
+
+/**
+ * The positions a virtual register is live between, inclusive
+ * Instruction i reads its operands at position 2i and writes its result at 2i + 1, so the result of an instruction
+ * can go in the register of an operand that is not read again
+ */
+struct Interval {
+    std::size_t reg = 0;
+    int start = INT_MAX;
+    int end = -1;
+    // Whether the register holds a value across a call to a function that may overwrite the $t registers
+    bool crosses_call = false;
+};
+
+/**
+ * Assigns machine registers to the virtual registers of one function by linear scan
+ * Values that are held across calls go in the callee-saved registers, which the frame saves (see `build_frame`), and
+ * other values go in the $t registers, or in callee-saved registers once the $t registers run out
+ * Registers that do not fit are spilled to stack slots, and $t registers that hold values across a call to a
+ * predefined function that overwrites them are saved and restored around it
+ */
+class Allocator {
+public:
+    Allocator(Function &function, const std::unordered_map<std::string_view, RegSet> &clobbers);
+    void run();
+
+private:
+    Function &function;
+    const std::unordered_map<std::string_view, RegSet> &clobbers;
+    std::size_t count = 0;
+    // The machine register of each virtual register, `None` for spilled registers
+    std::vector<Reg> assigned;
+    // The stack slot of each spilled virtual register, or -1
+    std::vector<int> slots;
+    // The registers that carry a spilled register to or from its slot, these are never spilled themselves
+    std::vector<bool> temporary;
+    std::vector<Registers> live_in;
+    std::vector<Registers> live_out;
+    int slot_count = 0;
+
+    std::size_t add_register(bool is_temporary);
+    int add_slot();
+    void compute_liveness();
+    std::vector<Interval> intervals() const;
+    bool scan();
+    void spill();
+    void save_around_calls();
+    void replace();
+    void grow_frame();
+};
+
+Allocator::Allocator(Function &function, const std::unordered_map<std::string_view, RegSet> &clobbers)
+        : function(function), clobbers(clobbers) {
+    std::uint32_t highest = first_virtual;
+    for (auto &block: function.blocks)
+        for (auto &instruction: block.instructions)
+            for (auto reg: {instruction.rd, instruction.rs, instruction.rt})
+                highest = std::max(highest, static_cast<std::uint32_t>(reg) + 1);
+    for (auto i = first_virtual; i < highest; i++)
+        add_register(false);
+}
+
+/**
+ * Allocates until nothing is left to spill, then rewrites the function to use machine registers only
+ */
+void Allocator::run() {
+    compute_liveness();
+    while (scan()) {
+        spill();
+        compute_liveness();
+    }
+    save_around_calls();
+    replace();
+    grow_frame();
+}
+
+std::size_t Allocator::add_register(bool is_temporary) {
+    assigned.push_back(Reg::None);
+    slots.push_back(-1);
+    temporary.push_back(is_temporary);
+    return count++;
+}
+
+/**
+ * @return the offset of a new stack slot, above the slots the function was lowered with
+ */
+int Allocator::add_slot() {
+    return function.frame_size + 4 * slot_count++;
+}
+
+/**
+ * Computes the virtual registers that are live at the start and end of each block
+ */
+void Allocator::compute_liveness() {
+    auto &blocks = function.blocks;
+    Graph graph(function);
+    std::vector<Registers> uses(blocks.size()), defs(blocks.size());
+    std::vector<bool> read(count), written(count);
+    for (std::size_t i = 0; i < blocks.size(); i++) {
+        auto &instructions = blocks[i].instructions;
+        for (auto instruction = instructions.rbegin(); instruction != instructions.rend(); ++instruction) {
+            if (writes(*instruction) && is_virtual(instruction->rd)) {
+                auto reg = number(instruction->rd);
+                read[reg] = false;
+                if (!written[reg]) {
+                    written[reg] = true;
+                    defs[i].push_back(reg);
+                }
+            }
+            for (auto reg: {instruction->rs, instruction->rt}) {
+                if (is_virtual(reg) && !read[number(reg)]) {
+                    read[number(reg)] = true;
+                    uses[i].push_back(number(reg));
+                }
+            }
+        }
+        // Keep the registers that are read before they are written, and clear the marks for the next block
+        uses[i].erase(std::remove_if(uses[i].begin(), uses[i].end(), [&](std::size_t reg) {
+            return !read[reg];
+        }), uses[i].end());
+        for (auto reg: uses[i])
+            read[reg] = false;
+        for (auto reg: defs[i])
+            written[reg] = false;
+        std::sort(uses[i].begin(), uses[i].end());
+        std::sort(defs[i].begin(), defs[i].end());
+    }
+
+    live_in.assign(blocks.size(), {});
+    live_out.assign(blocks.size(), {});
+    auto changed = true;
+    while (changed) {
+        changed = false;
+        for (auto i = blocks.size(); i-- > 0;) {
+            Registers live;
+            for (auto successor: graph.successors(i)) {
+                if (successor == Graph::none)
+                    continue;
+                Registers merged;
+                std::set_union(live.begin(), live.end(), live_in[successor].begin(), live_in[successor].end(),
+                               std::back_inserter(merged));
+                live = std::move(merged);
+            }
+            Registers through, in;
+            std::set_difference(live.begin(), live.end(), defs[i].begin(), defs[i].end(), std::back_inserter(through));
+            std::set_union(uses[i].begin(), uses[i].end(), through.begin(), through.end(), std::back_inserter(in));
+            live_out[i] = std::move(live);
+            if (in != live_in[i]) {
+                live_in[i] = std::move(in);
+                changed = true;
+            }
+        }
+    }
+}
+
+/**
+ * @return the interval of each virtual register that is used, ordered by start
+ */
+std::vector<Interval> Allocator::intervals() const {
+    std::vector<Interval> spans(count);
+    auto extend = [&](std::size_t reg, int position) {
+        spans[reg].reg = reg;
+        spans[reg].start = std::min(spans[reg].start, position);
+        spans[reg].end = std::max(spans[reg].end, position);
+    };
+
+    // The positions of the calls that may overwrite the $t registers
+    std::vector<int> calls;
+    int position = 0;
+    for (std::size_t i = 0; i < function.blocks.size(); i++) {
+        auto &instructions = function.blocks[i].instructions;
+        auto first = position;
+        auto last = position + 2 * static_cast<int>(instructions.size()) - 1;
+        for (auto reg: live_in[i])
+            extend(reg, first);
+        for (auto reg: live_out[i])
+            extend(reg, last);
+        for (auto &instruction: instructions) {
+            for (auto reg: {instruction.rs, instruction.rt})
+                if (is_virtual(reg))
+                    extend(number(reg), position);
+            if (writes(instruction) && is_virtual(instruction.rd))
+                extend(number(instruction.rd), position + 1);
+            if (instruction.op == Opcode::Jal && !clobbers.count(instruction.name.text))
+                calls.push_back(position);
+            position += 2;
+        }
+    }
+
+    for (auto &span: spans) {
+        auto call = std::upper_bound(calls.begin(), calls.end(), span.start);
+        span.crosses_call = call != calls.end() && *call + 1 < span.end;
+    }
+
+    spans.erase(std::remove_if(spans.begin(), spans.end(), [](const Interval &span) {
+        return span.end < 0;
+    }), spans.end());
+    std::stable_sort(spans.begin(), spans.end(), [](const Interval &a, const Interval &b) {
+        return a.start < b.start;
+    });
+    return spans;
+}
+
+/**
+ * Assigns a machine register to every interval, spilling the interval that ends last when none is free
+ * A value held across a call only displaces another value in a callee-saved register, as a spilled value costs
+ * less than saving a $t register around every call
+ * Free registers are handed out in the order they were freed, so a value stays in its register for as long as
+ * possible after its last use, where the peephole optimizer can still find it
+ * The callee-saved registers handed out are the ones `build_frame` saves, as both come from `callee_saved`
+ * @return whether any register was spilled
+ */
+bool Allocator::scan() {
+    std::vector<Interval> active;
+    std::deque<Reg> scratch, saved;
+    auto preserved = callee_saved();
+    auto is_saved = [&](Reg reg) { return preserved.test(static_cast<std::size_t>(reg)); };
+    for (auto reg: allocatable)
+        (is_saved(reg) ? saved : scratch).push_back(reg);
+    auto spilled = false;
+    for (auto &span: intervals()) {
+        active.erase(std::remove_if(active.begin(), active.end(), [&](const Interval &other) {
+            if (other.end >= span.start)
+                return false;
+            auto reg = assigned[other.reg];
+            (is_saved(reg) ? saved : scratch).push_back(reg);
+            return true;
+        }), active.end());
+
+        auto &free = span.crosses_call || scratch.empty() ? saved : scratch;
+        if (!free.empty()) {
+            assigned[span.reg] = free.front();
+            free.pop_front();
+            active.push_back(span);
+            continue;
+        }
+
+        auto victim = active.end();
+        for (auto other = active.begin(); other != active.end(); ++other)
+            if (!temporary[other->reg] && (victim == active.end() || other->end > victim->end) &&
+                (!span.crosses_call || is_saved(assigned[other->reg])))
+                victim = other;
+        spilled = true;
+        if (!temporary[span.reg] && (victim == active.end() || victim->end <= span.end)) {
+            assigned[span.reg] = Reg::None;
+            slots[span.reg] = add_slot();
+            continue;
+        }
+        assigned[span.reg] = assigned[victim->reg];
+        assigned[victim->reg] = Reg::None;
+        slots[victim->reg] = add_slot();
+        *victim = span;
+    }
+    return spilled;
+}
+
+/**
+ * Rewrites the uses of spilled registers into loads from their slots, and their definitions into stores to them
+ * Each load or store goes through a new temporary register that is live for a single instruction
+ */
+void Allocator::spill() {
+    for (auto &block: function.blocks) {
+        std::vector<Instruction> instructions;
+        instructions.reserve(block.instructions.size());
+        for (auto instruction: block.instructions) {
+            Reg original = Reg::None, carrier = Reg::None;
+            for (auto reg: {&instruction.rs, &instruction.rt}) {
+                if (!is_virtual(*reg) || slots[number(*reg)] < 0)
+                    continue;
+                if (*reg != original) {
+                    original = *reg;
+                    carrier = virtual_register(static_cast<int>(add_register(true)));
+                    instructions.push_back(Instruction::load(carrier, {{}, Reg::Sp, slots[number(original)]}));
+                }
+                *reg = carrier;
+            }
+
+            auto defined = writes(instruction) && is_virtual(instruction.rd) && slots[number(instruction.rd)] >= 0;
+            if (defined) {
+                auto slot = slots[number(instruction.rd)];
+                if (instruction.rd != original)
+                    carrier = virtual_register(static_cast<int>(add_register(true)));
+                instruction.rd = carrier;
+                instructions.push_back(instruction);
+                instructions.push_back(Instruction::store(carrier, {{}, Reg::Sp, slot}));
+            } else {
+                instructions.push_back(instruction);
+            }
+        }
+        block.instructions = std::move(instructions);
+    }
+}
+
+/**
+ * Saves the registers that hold values across each call before it, and restores them after it
+ * Only registers that are read after the call and that the callee may overwrite are saved, each machine register
+ * has its own slot
+ */
+void Allocator::save_around_calls() {
+    std::array<int, allocatable.size()> save_slots;
+    save_slots.fill(-1);
+    for (std::size_t i = 0; i < function.blocks.size(); i++) {
+        auto &instructions = function.blocks[i].instructions;
+        // The machine registers to save around each instruction, empty for anything but calls
+        // Values that are live at the same time are in different registers, so the live registers stand for them
+        std::vector<RegSet> saved(instructions.size());
+        RegSet live;
+        for (auto reg: live_out[i])
+            live.set(static_cast<std::size_t>(assigned[reg]));
+        for (auto j = instructions.size(); j-- > 0;) {
+            auto &instruction = instructions[j];
+            if (instruction.op == Opcode::Jal) {
+                auto callee = clobbers.find(instruction.name.text);
+                saved[j] = live & (callee == clobbers.end() ? ~callee_saved() : callee->second);
+            }
+            if (writes(instruction) && is_virtual(instruction.rd))
+                live.reset(static_cast<std::size_t>(assigned[number(instruction.rd)]));
+            for (auto reg: {instruction.rs, instruction.rt})
+                if (is_virtual(reg))
+                    live.set(static_cast<std::size_t>(assigned[number(reg)]));
+        }
+
+        std::vector<Instruction> rewritten;
+        rewritten.reserve(instructions.size());
+        for (std::size_t j = 0; j < instructions.size(); j++) {
+            for (std::size_t reg = 0; reg < allocatable.size(); reg++) {
+                if (!saved[j].test(static_cast<std::size_t>(allocatable[reg])))
+                    continue;
+                if (save_slots[reg] < 0)
+                    save_slots[reg] = add_slot();
+                rewritten.push_back(Instruction::store(allocatable[reg], {{}, Reg::Sp, save_slots[reg]}));
+            }
+            rewritten.push_back(instructions[j]);
+            for (std::size_t reg = 0; reg < allocatable.size(); reg++)
+                if (saved[j].test(static_cast<std::size_t>(allocatable[reg])))
+                    rewritten.push_back(Instruction::load(allocatable[reg], {{}, Reg::Sp, save_slots[reg]}));
+        }
+        instructions = std::move(rewritten);
+    }
+}
+
+/**
+ * Replaces every virtual register by the machine register assigned to it
+ */
+void Allocator::replace() {
+    for (auto &block: function.blocks)
+        for (auto &instruction: block.instructions)
+            for (auto reg: {&instruction.rd, &instruction.rs, &instruction.rt})
+                if (is_virtual(*reg))
+                    *reg = assigned[number(*reg)];
+}
+
+/**
+ * Grows the frame by the slots that were added
+ */
+void Allocator::grow_frame() {
+    function.frame_size += 4 * slot_count;
+}
+
+}
+
+/**
+ * Replaces the virtual registers of a function by machine registers (-O1)
+ * A call may overwrite every register but the callee-saved ones, unless the callee is known to overwrite fewer
+ * Spilled values and saved registers get stack slots past the frame size of the function, which grows to hold them
+ * @param function the function, which has no stack frame yet
+ * @param clobbers the registers overwritten by the functions that are known to leave the others alone, by name
+ */
+void allocate_registers(Function &function, const std::unordered_map<std::string_view, RegSet> &clobbers) {
+    Allocator(function, clobbers).run();
+}
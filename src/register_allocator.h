@@ -0,0 +1,8 @@
+#pragma once
+
+#include <string_view>
+#include <unordered_map>
+
+#include "mir.h"
+
+void allocate_registers(Function &function, const std::unordered_map<std::string_view, RegSet> &clobbers);
@@ -28,10 +28,11 @@ void ReplInput::read() {
     std::cout << ">>> " << std::flush;
     std::string line;
     while((line = read_line()).length() != 0) {
-        Input::data.append(line);
-        Input::data.append("\n");
+        buffer.append(line);
+        buffer.append("\n");
         std::cout << "... " << std::flush;
     }
+    Input::data = buffer;
 }
 
 
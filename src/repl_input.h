@@ -7,4 +7,7 @@ class ReplInput : public Input {
 public:
     ReplInput();
     void read() override;
+
+private:
+    std::string buffer;
 };
@@ -0,0 +1,143 @@
+#include "scanner.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * Thin wrappers around the widest vector instructions the compiler targets
+ * Every comparison yields a byte mask, which is collapsed to one bit per byte by `mask`
+ */
+#if defined(__AVX2__)
+#define SCANNER_SIMD
+using Vector = __m256i;
+using Mask = std::uint32_t;
+constexpr int width = 32;
+constexpr Mask full_mask = 0xFFFFFFFF;
+
+static inline Vector load(const char *bytes) { return _mm256_loadu_si256(reinterpret_cast<const Vector *>(bytes)); }
+static inline Vector either(Vector a, Vector b) { return _mm256_or_si256(a, b); }
+static inline Vector both(Vector a, Vector b) { return _mm256_and_si256(a, b); }
+static inline Vector equal(Vector v, char c) { return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)); }
+static inline Vector greater(Vector v, char c) { return _mm256_cmpgt_epi8(v, _mm256_set1_epi8(c)); }
+static inline Vector less(Vector v, char c) { return _mm256_cmpgt_epi8(_mm256_set1_epi8(c), v); }
+static inline Mask mask(Vector v) { return static_cast<Mask>(_mm256_movemask_epi8(v)); }
+#elif defined(__SSE2__)
+#define SCANNER_SIMD
+using Vector = __m128i;
+using Mask = std::uint32_t;
+constexpr int width = 16;
+constexpr Mask full_mask = 0xFFFF;
+
+static inline Vector load(const char *bytes) { return _mm_loadu_si128(reinterpret_cast<const Vector *>(bytes)); }
+static inline Vector either(Vector a, Vector b) { return _mm_or_si128(a, b); }
+static inline Vector both(Vector a, Vector b) { return _mm_and_si128(a, b); }
+static inline Vector equal(Vector v, char c) { return _mm_cmpeq_epi8(v, _mm_set1_epi8(c)); }
+static inline Vector greater(Vector v, char c) { return _mm_cmpgt_epi8(v, _mm_set1_epi8(c)); }
+static inline Vector less(Vector v, char c) { return _mm_cmplt_epi8(v, _mm_set1_epi8(c)); }
+static inline Mask mask(Vector v) { return static_cast<Mask>(_mm_movemask_epi8(v)); }
+#endif
+
+#ifdef SCANNER_SIMD
+/**
+ * Matches every byte within the inclusive range [low, high]
+ * Bytes above 0x7f compare as negative, so they never fall within an ascii range
+ */
+static inline Vector within(Vector v, char low, char high) {
+    return both(greater(v, low - 1), less(v, high + 1));
+}
+#endif
+
+/**
+ * Advances past every character for which `member` holds
+ * Whole vectors are tested at a time, then the remaining tail is scanned one character at a time
+ * @param data the source buffer
+ * @param position the position to start skipping from
+ * @param vector_member produces a byte mask of the members in a vector
+ * @param scalar_member checks if a single character is a member
+ * @return the position of the first non-member character, or the end of the buffer
+ */
+template<typename VectorMember, typename ScalarMember>
+static inline int skip(std::string_view data, int position, VectorMember vector_member, ScalarMember scalar_member) {
+    const char *bytes = data.data();
+    int end = data.length();
+
+#ifdef SCANNER_SIMD
+    while (position + width <= end) {
+        Mask members = mask(vector_member(load(bytes + position)));
+        if (members != full_mask)
+            return position + __builtin_ctz(~members & full_mask);
+        position += width;
+    }
+#endif
+
+    while (position < end && scalar_member(bytes[position]))
+        position++;
+    return position;
+}
+
+/**
+ * Skips a run of spaces, tabs and carriage returns (but not newlines)
+ * @param data the source buffer
+ * @param position the position to start skipping from
+ * @return the position of the first non-whitespace character
+ */
+int Scanner::skip_whitespace(std::string_view data, int position) {
+    return skip(data, position,
+                [](auto v) { return either(either(equal(v, ' '), equal(v, '\t')), equal(v, '\r')); },
+                [](char c) { return is(c, Whitespace); });
+}
+
+/**
+ * Skips a run of decimal digits
+ * @param data the source buffer
+ * @param position the position to start skipping from
+ * @return the position of the first non-digit character
+ */
+int Scanner::skip_digits(std::string_view data, int position) {
+    return skip(data, position,
+                [](auto v) { return within(v, '0', '9'); },
+                [](char c) { return is(c, Digit); });
+}
+
+/**
+ * Skips a run of identifier characters (letters, digits and underscores)
+ * @param data the source buffer
+ * @param position the position to start skipping from
+ * @return the position of the first non-identifier character
+ */
+int Scanner::skip_alphanumeric(std::string_view data, int position) {
+    return skip(data, position,
+                [](auto v) {
+                    return either(either(within(v, 'a', 'z'), within(v, 'A', 'Z')),
+                                  either(within(v, '0', '9'), equal(v, '_')));
+                },
+                [](char c) { return is(c, Alphanumeric); });
+}
+
+/**
+ * Skips the body of a line comment
+ * @param data the source buffer
+ * @param position the position to start skipping from
+ * @return the position of the terminating newline, or the end of the buffer
+ */
+int Scanner::skip_comment(std::string_view data, int position) {
+    return skip(data, position,
+                [](auto v) { return ~equal(v, '\n'); },
+                [](char c) { return c != '\n'; });
+}
+
+/**
+ * Skips the ordinary characters of a string literal body
+ * Stops at anything the lexer has to look at itself: a closing quote, an escape, or an (illegal) newline
+ * @param data the source buffer
+ * @param position the position to start skipping from
+ * @return the position of the first special character, or the end of the buffer
+ */
+int Scanner::skip_string(std::string_view data, int position) {
+    return skip(data, position,
+                [](auto v) { return ~either(either(equal(v, '"'), equal(v, '\\')), equal(v, '\n')); },
+                [](char c) { return c != '"' && c != '\\' && c != '\n'; });
+}
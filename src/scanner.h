@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+/**
+ * Character classes used by the lexer
+ * A character may belong to more than one class, so these are bit flags
+ */
+enum CharClass : std::uint8_t {
+    None = 0,
+    Whitespace = 1 << 0,
+    Digit = 1 << 1,
+    Alpha = 1 << 2,
+    Alphanumeric = Digit | Alpha,
+};
+
+/**
+ * Builds the 256-entry character class table at compile time
+ * @return the character class of every possible byte
+ */
+constexpr std::array<std::uint8_t, 256> make_char_classes() {
+    std::array<std::uint8_t, 256> table = {};
+    table[' '] = table['\t'] = table['\r'] = Whitespace;
+    for (int c = '0'; c <= '9'; c++)
+        table[c] = Digit;
+    for (int c = 'a'; c <= 'z'; c++)
+        table[c] = Alpha;
+    for (int c = 'A'; c <= 'Z'; c++)
+        table[c] = Alpha;
+    table['_'] = Alpha;
+    return table;
+}
+
+inline constexpr std::array<std::uint8_t, 256> char_classes = make_char_classes();
+
+/**
+ * Skips over runs of characters in the source buffer
+ * Uses AVX2 or SSE2 when the compiler targets them, falling back to a scalar loop for the tail
+ * None of the runs cross a newline, so the caller only has to adjust its column
+ */
+class Scanner {
+public:
+    static bool is(char c, CharClass char_class);
+    static int skip_whitespace(std::string_view data, int position);
+    static int skip_digits(std::string_view data, int position);
+    static int skip_alphanumeric(std::string_view data, int position);
+    static int skip_comment(std::string_view data, int position);
+    static int skip_string(std::string_view data, int position);
+};
+
+/**
+ * Checks if the given character belongs to the given class
+ * @param c the character to check
+ * @param char_class the class (or union of classes) to check against
+ * @return true if the character belongs to the class, false otherwise
+ */
+inline bool Scanner::is(char c, CharClass char_class) {
+    return char_classes[static_cast<unsigned char>(c)] & char_class;
+}
@@ -1,13 +1,15 @@
 #pragma once
 
+#include <array>
 #include <vector>
-#include <map>
-#include <set>
+#include <optional>
 #include <string>
+#include <string_view>
 
 #include "input.h"
 #include "ast.h"
 #include "symbol_table.h"
+#include "universe.h"
 
 /**
  * An identifier is redefined within the same scope.
@@ -38,6 +40,16 @@
  * We can use a symbol table to help us track declarations and types
  */
 
+/**
+ * An error that is only reported once every function has been checked
+ */
+struct DeferredError {
+	int line;
+	int column;
+	int width;
+	std::string message;
+};
+
 class Semantic {
 public:
 	Semantic(Input *input, AST ast);
@@ -49,62 +61,58 @@ private:
 	AST ast;
 	SymbolTable symbol_table;
 
-	std::string check_binary(AST *ast);
+	// Control flow state, carried from one function to the next
+	int for_depth = 0;
+	int main_count = 0;
+	const Type *unreturned = nullptr;
+	bool has_returned = false;
 
-	std::string check_unary(AST *ast);
+	// The first error of each kind that is reported after the walk
+	std::optional<DeferredError> type_error;
+	std::optional<DeferredError> flow_error;
 
-	std::string encode_func_decl(AST *ast);
+	const Type *check_binary(AST ast);
 
-	std::string encode_func_call(AST *ast);
+	const Type *check_unary(AST ast);
 
-	void pass_0();
+	const Type *encode_func_decl(AST ast);
 
-	void pass_1();
-
-	void pass_2();
+	const Type *encode_func_call(AST ast);
 
-	void pass_3();
+	void defer(std::optional<DeferredError> &error, int line, int column, int width, std::string message);
 
-	void pass_4();
-};
+	void report();
 
-using BinaryOpTable = std::map<std::string, std::vector<std::tuple<std::string, std::string, std::string>>>;
-inline BinaryOpTable legal_binary = {
-		{"&&", {{"bool", "bool", "bool"}}},
-		{"||", {{"bool", "bool", "bool"}}},
-		{"==", {{"bool", "bool", "bool"}, {"int", "int", "bool"}, {"str", "str", "bool"}}},
-		{"!=", {{"bool", "bool", "bool"}, {"int", "int", "bool"}, {"str", "str", "bool"}}},
-		{">=", {{"int",  "int",  "bool"}, {"str",  "str",  "bool"}}},
-		{">",  {{"int",  "int",  "bool"}, {"str",  "str",  "bool"}}},
-		{"<=", {{"int",  "int",  "bool"}, {"str",  "str",  "bool"}}},
-		{"<",  {{"int",  "int",  "bool"}, {"str",  "str",  "bool"}}},
-		{"*",  {{"int",  "int",  "int"}}},
-		{"/",  {{"int",  "int",  "int"}}},
-		{"%",  {{"int",  "int",  "int"}}},
-		{"+",  {{"int",  "int",  "int"}}},
-		{"-",  {{"int",  "int",  "int"}}},
-};
-
-using UnaryOpTable = std::map<std::string, std::vector<std::tuple<std::string, std::string>>>;
-inline UnaryOpTable legal_unary = {
-		{"!",  {{"bool", "bool"}}},
-		{"u-", {{"int",  "int"}}}
-};
+	void pass_1();
 
-inline std::vector<std::pair<std::string, Record>> universal_records = {
-		{"$void",   {"void",    "",     false, true}},
-		{"bool",    {"bool",    "",     false, true}},
-		{"int",     {"int",     "",     false, true}},
-		{"string",  {"str",     "",     false, true}},
-		{"$true",   {"bool",    "",     true,  false}},
-		{"true",    {"bool",    "",     true,  false}},
-		{"false",   {"bool",    "",     true,  false}},
-		{"printb",  {"f(bool)", "void", false, false}},
-		{"printc",  {"f(int)",  "void", false, false}},
-		{"printi",  {"f(int)",  "void", false, false}},
-		{"prints",  {"f(str)",  "void", false, false}},
-		{"getchar", {"f()",     "int",  false, false}},
-		{"halt",    {"f()",     "void", false, false}},
-		{"len",     {"f(str)",  "int",  false, false}},
+	void pass_2(AST func);
 };
 
+/**
+ * Builds the table of legal operators, giving the result type of each operator for each operand type
+ * Both operands of a binary operator must have the same type, illegal combinations give `TypeKind::None`
+ * @return the table, indexed by operator and then by operand type
+ */
+constexpr auto make_operator_types() {
+	std::array<std::array<TypeKind, type_kinds>, node_kinds> table{};
+	for (std::size_t op = 0; op < node_kinds; op++)
+		for (std::size_t operand = 0; operand < type_kinds; operand++)
+			table[op][operand] = TypeKind::None;
+
+	auto legal = [&table](NodeKind op, TypeKind operand, TypeKind result) {
+		table[static_cast<std::size_t>(op)][static_cast<std::size_t>(operand)] = result;
+	};
+	for (auto op: {NodeKind::And, NodeKind::Or, NodeKind::Not})
+		legal(op, TypeKind::Bool, TypeKind::Bool);
+	for (auto op: {NodeKind::Equal, NodeKind::NotEqual})
+		legal(op, TypeKind::Bool, TypeKind::Bool);
+	for (auto op: {NodeKind::Equal, NodeKind::NotEqual, NodeKind::GreaterEqual, NodeKind::Greater, NodeKind::LessEqual, NodeKind::Less}) {
+		legal(op, TypeKind::Int, TypeKind::Bool);
+		legal(op, TypeKind::Str, TypeKind::Bool);
+	}
+	for (auto op: {NodeKind::Multiply, NodeKind::Divide, NodeKind::Modulo, NodeKind::Add, NodeKind::Subtract, NodeKind::Negate})
+		legal(op, TypeKind::Int, TypeKind::Int);
+	return table;
+}
+
+inline constexpr auto operator_types = make_operator_types();
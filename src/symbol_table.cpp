@@ -2,74 +2,122 @@
 #include <iomanip>
 
 #include "symbol_table.h"
+#include "universe.h"
 #include "logger.h"
 
-SymbolTable::SymbolTable(Input *input): input(input), scopes(0) { }
+/**
+ * SymbolTable class constructor
+ * Only the universe scope is open, it is shared rather than populated
+ * @param input the input that diagnostics refer to
+ * @param arena the arena of the compilation, which holds the records and must outlive the symbol table
+ */
+SymbolTable::SymbolTable(Input *input, Arena &arena): input(input), arena(arena), bindings(&arena), innermost(&arena) { }
+
+/**
+ * Gets the records of the universe scope, indexed by their fixed symbol ids
+ * They are built the first time they are needed, and then shared by every compilation
+ * @return the universe records
+ */
+std::vector<Record> &SymbolTable::universe() {
+    static std::vector<Record> records = [] {
+        std::vector<Record> records;
+        for (const auto &record: universal_records)
+            records.push_back({Type::parse(record.sig), Type::parse(record.rt_sig), record.is_const, record.is_type});
+        return records;
+    }();
+    return records;
+}
+
+/**
+ * Gets the record of a universe name, without a symbol table
+ * @param symbol the fixed symbol id of the name, see `universe_id`
+ * @return the shared universe record
+ */
+Record *SymbolTable::predeclared(SymbolId symbol) {
+    return &universe()[symbol];
+}
 
-Record* SymbolTable::define(AST* ast, Record record) {
+Record* SymbolTable::define(AST ast, Record record) {
     // What info do we need from the ast
-    auto name = ast->attr;
-    auto line = ast->line;
-    auto column = ast->column;
+    auto symbol = ast.symbol();
+    auto name = ast.attr();
+    auto line = ast.line();
+    auto column = ast.column();
 
-    // Check if a record with the given name already exists
-    if (scopes.back().count(name))
-        Logger::error(input, line, column, name.length(), "\"" + name + "\"" + " redefined");
+    if (symbol >= innermost.size())
+        innermost.resize(symbol + 1, -1);
 
-    // Create and insert new record
-    return define(name, record);
-}
+    // Check if a record with the given name already exists in this scope
+    auto &top = innermost[symbol];
+    if (top >= 0 && bindings[top].depth == depth)
+        Logger::error(input, line, column, name.length(), "\"" + std::string(name) + "\"" + " redefined");
 
-Record* SymbolTable::define(std::string name, Record record) {
     // Create and insert new record
-    return &(scopes.back()[name] = record);
+    auto defined = arena.create<Record>(record);
+    bindings.push_back({symbol, depth, top, name, defined});
+    top = bindings.size() - 1;
+    return defined;
 }
 
-
-Record* SymbolTable::lookup(AST* ast) {
+Record* SymbolTable::lookup(AST ast) {
     // What info do we need from the ast
-    auto name = ast->attr;
-    auto line = ast->line;
-    auto column = ast->column;
+    auto symbol = ast.symbol();
+    auto name = ast.attr();
+    auto line = ast.line();
+    auto column = ast.column();
 
-    // Find record, starting at the top-most scope
-    for (int i = scopes.size() - 1; i >= 0; i--)
-        if(scopes[i].count(name))
-            return &scopes[i][name];
+    // Find the innermost record, falling back to the universe
+    if (symbol < innermost.size() && innermost[symbol] >= 0)
+        return bindings[innermost[symbol]].record;
+    if (symbol < universe().size())
+        return &universe()[symbol];
 
     // Error if no record exists
-    Logger::error(input, line, column, name.length(), "unknown identifier \"" + name + "\"");
+    Logger::error(input, line, column, name.length(), "unknown identifier \"" + std::string(name) + "\"");
 	throw 0;
 }
 
-Record* SymbolTable::lookup(std::string name) {
-    // Find record, starting at the top-most scope
-    for (int i = scopes.size() - 1; i >= 0; i--)
-        if(scopes[i].count(name))
-            return &scopes[i][name];
+Record* SymbolTable::lookup(SymbolId symbol) {
+    // Find the innermost record, falling back to the universe
+    if (symbol < innermost.size() && innermost[symbol] >= 0)
+        return bindings[innermost[symbol]].record;
+    if (symbol < universe().size())
+        return &universe()[symbol];
 
     // Error if no record exists
-    Logger::error(input, 0, 0, name.length(), "unknown identifier \"" + name + "\"");
+    Logger::error(input, 0, 0, 1, "unknown identifier");
 	throw 0;
 }
 
 void SymbolTable::open_scope() {
-    scopes.push_back({});
+    depth++;
 }
 
 void SymbolTable::close_scope() {
-    if(scopes.size() == 1)
+    if(depth == 0)
         Logger::error(input, 0, 0, 1, "cannot pop the universe scope");
-    scopes.pop_back();
+
+    // Unwind the bindings of the scope, uncovering whatever they shadowed
+    while (!bindings.empty() && bindings.back().depth == depth) {
+        innermost[bindings.back().symbol] = bindings.back().shadowed;
+        bindings.pop_back();
+    }
+    depth--;
 }
 
 void SymbolTable::print() {
-	for (int i = scopes.size() - 1; i >= 0; i--)
+	for (int i = depth; i >= 0; i--)
 		print_scope(i);
 }
 
 void SymbolTable::print_scope(int i) {
 	std::cout << "Scope " << i << ":" << std::endl;
-	for(auto record : scopes.at(i))
-		std::cout << "[" << std::setw(10) << std::left << record.first <<"] " << record.second << std::endl;
+	if (i == 0) {
+		for (SymbolId symbol = 0; symbol < universe().size(); symbol++)
+			std::cout << "[" << std::setw(10) << std::left << universal_records[symbol].name << "] " << universe()[symbol] << std::endl;
+		return;
+	}
+	for (auto &binding : bindings)
+		if (binding.depth == i)
+			std::cout << "[" << std::setw(10) << std::left << binding.name << "] " << *binding.record << std::endl;
 }
@@ -1,28 +1,52 @@
 #pragma once
 
 #include <vector>
-#include <map>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <iostream>
 
+#include "arena.h"
 #include "input.h"
 #include "ast.h"
+#include "interner.h"
 #include "record.h"
 
+/**
+ * Scoped symbol table keyed by interned symbol ids
+ * Every symbol has a stack of bindings, threaded through one shadow stack shared by all scopes,
+ * so define, lookup and closing a scope are all O(1) (amortized per binding)
+ * The universe scope sits below every other scope, and is built once per process
+ */
 class SymbolTable {
 public:
-    SymbolTable(Input* input);
-	Record* define(AST* ast, Record record);
-	Record* define(std::string name, Record record);
-    Record* lookup(AST* ast);
-    Record* lookup(std::string name);
+    SymbolTable(Input* input, Arena &arena);
+	Record* define(AST ast, Record record);
+    Record* lookup(AST ast);
+    Record* lookup(SymbolId symbol);
     void open_scope();
     void close_scope();
     void print();
     void print_scope(int i);
+    static Record *predeclared(SymbolId symbol);
 
 private:
+    struct Binding {
+        SymbolId symbol;
+        int depth;
+        // The binding of the same symbol that this one shadows, or -1
+        int shadowed;
+        std::string_view name;
+        Record *record;
+    };
+
     Input* input;
-    std::vector<std::map<std::string, Record>> scopes;
-};
+    // Records are never moved or freed during a compilation, so the ast can keep pointers to them
+    Arena &arena;
+    int depth = 0;
+    std::pmr::vector<Binding> bindings;
+    // The innermost binding of each symbol, or -1
+    std::pmr::vector<int> innermost;
 
+    static std::vector<Record> &universe();
+};
@@ -4,12 +4,12 @@
 /**
  * Constructs a new `Token` object with the given type, lexeme, line and column.
  * @param type the type of token
- * @param lexeme the string representation of the token
+ * @param lexeme a view of the token in the source buffer
  * @param line the line number in the source code where the token is found
  * @param column the column number in the source code where the token is found
  */
-Token::Token(TokenType type, const std::string &lexeme, int line, int column) : type(type), lexeme(lexeme), line(line),
-                                                                                column(column) {}
+Token::Token(TokenType type, std::string_view lexeme, int line, int column) : type(type), lexeme(lexeme), line(line),
+                                                                              column(column) {}
 /**
  * Overloading the output stream operator to print the `TokenType`
  * Formats as a human-readable string
@@ -96,8 +96,19 @@ std::ostream &operator<<(std::ostream &os, TokenType tokenType) {
  * @param token the token to print
  * @return the updated output stream
  */
-std::ostream &operator<<(std::ostream &os, Token token) {
+std::ostream &operator<<(std::ostream &os, const Token &token) {
     return os << std::setw(8) << std::left << token.type << " [" << token.lexeme << "] " << "@ (" << token.line << ", "
               << token.column << ")";
 }
 
+// Keyword recognition is resolved entirely at compile time
+static_assert(keyword("break") == Break);
+static_assert(keyword("else") == Else);
+static_assert(keyword("for") == For);
+static_assert(keyword("func") == Func);
+static_assert(keyword("if") == If);
+static_assert(keyword("return") == Return);
+static_assert(keyword("var") == Var);
+static_assert(keyword("fun") == Identifier);
+static_assert(keyword("iff") == Identifier);
+static_assert(keyword("elsewhere") == Identifier);
@@ -1,8 +1,9 @@
 #pragma once
 
-#include <map>
 #include <string>
+#include <string_view>
 #include <iostream>
+#include "interner.h"
 
 enum TokenType {
     // Punctuation
@@ -53,26 +54,53 @@ enum TokenType {
     Eof,
 };
 
-static std::map<std::string, TokenType> Keywords = {
-        {"break", Break},
-        {"else", Else},
-        {"for", For},
-        {"func", Func},
-        {"if", If},
-        {"return", Return},
-        {"var", Var},
-};
+/**
+ * Recognizes keywords with a switch on the length and then the first character of the lexeme
+ * This leaves at most one string comparison per identifier, and needs no table to be built at startup
+ * @param lexeme the lexeme of an identifier-like token
+ * @return the keyword token type, or Identifier if the lexeme is not a keyword
+ */
+constexpr TokenType keyword(std::string_view lexeme) {
+    auto is = [&](std::string_view keyword, TokenType type) {
+        return lexeme == keyword ? type : Identifier;
+    };
+
+    switch (lexeme.length()) {
+        case 2: return is("if", If);
+        case 3:
+            switch (lexeme[0]) {
+                case 'f': return is("for", For);
+                case 'v': return is("var", Var);
+            }
+            break;
+        case 4:
+            switch (lexeme[0]) {
+                case 'e': return is("else", Else);
+                case 'f': return is("func", Func);
+            }
+            break;
+        case 5: return is("break", Break);
+        case 6: return is("return", Return);
+    }
+    return Identifier;
+}
 
 std::ostream &operator<<(std::ostream &os, TokenType tokenType);
 
+/**
+ * A token does not own its lexeme, it is a view into the source buffer owned by the `Input`
+ * The input must therefore outlive every token that was lexed from it
+ */
 struct Token {
     TokenType type;
-    std::string lexeme;
+    std::string_view lexeme;
     int line;
     int column;
+    // Set for identifiers once they are interned by the lexer
+    SymbolId symbol = no_symbol;
 
-    Token(TokenType type, const std::string &lexeme, int line, int column);
+    Token(TokenType type, std::string_view lexeme, int line, int column);
 };
 
-std::ostream &operator<<(std::ostream &os, Token token);
+std::ostream &operator<<(std::ostream &os, const Token &token);
 
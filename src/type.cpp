@@ -0,0 +1,109 @@
+#include <mutex>
+#include <unordered_map>
+
+#include "type.h"
+
+/**
+ * The builtin types, in the order of their kinds
+ */
+static const Type builtins[] = {
+        {TypeKind::Void, "void", {}},
+        {TypeKind::Bool, "bool", {}},
+        {TypeKind::Int,  "int",  {}},
+        {TypeKind::Str,  "str",  {}},
+};
+
+/**
+ * Hashes a list of parameter types by the identity of each type
+ */
+struct ParamsHash {
+    std::size_t operator()(const std::vector<const Type *> &params) const {
+        std::size_t hash = params.size();
+        for (auto param: params)
+            hash = hash * 31 + std::hash<const Type *>()(param);
+        return hash;
+    }
+};
+
+// Every other type made so far, shared by all compilations (which may run on different threads)
+// The maps are node-based, so the address of a type never changes once it is inserted
+static std::mutex types_mutex;
+static std::unordered_map<std::string, Type> named_types;
+static std::unordered_map<std::vector<const Type *>, Type, ParamsHash> function_types;
+
+/**
+ * Gets a builtin type
+ * @param kind the kind of the builtin type
+ * @return the unique builtin type
+ */
+const Type *Type::basic(TypeKind kind) {
+    return &builtins[static_cast<std::size_t>(kind)];
+}
+
+/**
+ * Gets the type with the given name
+ * The builtin names give the builtin types, any other name gives a type that is only equal to itself
+ * @param name the name of the type
+ * @return the unique type with the given name
+ */
+const Type *Type::named(std::string_view name) {
+    for (auto &builtin: builtins)
+        if (builtin.name == name)
+            return &builtin;
+
+    std::lock_guard<std::mutex> lock(types_mutex);
+    auto [iter, inserted] = named_types.try_emplace(std::string(name), Type{TypeKind::Named, std::string(name), {}});
+    return &iter->second;
+}
+
+/**
+ * Gets the function type with the given parameter types
+ * The result type is not part of a function type, it is kept alongside it
+ * @param params the parameter types, a missing type is null
+ * @return the unique function type
+ */
+const Type *Type::function(const std::vector<const Type *> &params) {
+    std::lock_guard<std::mutex> lock(types_mutex);
+    auto iter = function_types.find(params);
+    if (iter != function_types.end())
+        return &iter->second;
+
+    std::string name = "f(";
+    for (int i = 0; i < params.size(); i++) {
+        name.append(name_of(params[i]));
+        if (i < params.size() - 1)
+            name.append(",");
+    }
+    name.append(")");
+    return &function_types.try_emplace(params, Type{TypeKind::Function, name, params}).first->second;
+}
+
+/**
+ * Gets the type written as a signature, either a type name or "f(" type names separated by "," ")"
+ * @param signature the printed form of the type, or an empty string
+ * @return the unique type, or null for an empty signature
+ */
+const Type *Type::parse(std::string_view signature) {
+    if (signature.empty())
+        return nullptr;
+    if (signature.substr(0, 2) != "f(")
+        return named(signature);
+
+    std::vector<const Type *> params;
+    auto list = signature.substr(2, signature.length() - 3);
+    while (!list.empty()) {
+        auto comma = list.find(',');
+        params.push_back(named(list.substr(0, comma)));
+        list = comma == std::string_view::npos ? "" : list.substr(comma + 1);
+    }
+    return function(params);
+}
+
+/**
+ * Gets the printed form of a type
+ * @param type the type, or null
+ * @return the name of the type, or an empty string for null
+ */
+std::string_view Type::name_of(const Type *type) {
+    return type ? std::string_view(type->name) : std::string_view();
+}
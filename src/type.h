@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * The kinds of types
+ * Each builtin type has a kind of its own, so it can index the operator tables
+ */
+enum class TypeKind : std::uint8_t {
+    Void,
+    Bool,
+    Int,
+    Str,
+    Named,
+    Function,
+    None,
+};
+
+inline constexpr std::size_t type_kinds = static_cast<std::size_t>(TypeKind::None);
+
+/**
+ * A type, hash-consed so that two types are equal exactly when they are the same object
+ * Types are immutable and are never freed, so handles to them can be shared by every compilation
+ */
+struct Type {
+    TypeKind kind;
+    // The printed form of the type ("int", "f(int,str)")
+    std::string name;
+    // The parameter types of a function type
+    std::vector<const Type *> params;
+
+    static const Type *basic(TypeKind kind);
+    static const Type *named(std::string_view name);
+    static const Type *function(const std::vector<const Type *> &params);
+    static const Type *parse(std::string_view signature);
+    static std::string_view name_of(const Type *type);
+};
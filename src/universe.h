@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <string_view>
+
+#include "interner.h"
+
+/**
+ * A predeclared identifier of the universe scope
+ * Kept as plain views so the whole table is constant-initialized
+ */
+struct UniversalRecord {
+	std::string_view name;
+	std::string_view sig;
+	std::string_view rt_sig;
+	bool is_const;
+	bool is_type;
+};
+
+inline constexpr std::array<UniversalRecord, 14> universal_records = {{
+		{"$void",   "void",    "",     false, true},
+		{"bool",    "bool",    "",     false, true},
+		{"int",     "int",     "",     false, true},
+		{"string",  "str",     "",     false, true},
+		{"$true",   "bool",    "",     true,  false},
+		{"true",    "bool",    "",     true,  false},
+		{"false",   "bool",    "",     true,  false},
+		{"printb",  "f(bool)", "void", false, false},
+		{"printc",  "f(int)",  "void", false, false},
+		{"printi",  "f(int)",  "void", false, false},
+		{"prints",  "f(str)",  "void", false, false},
+		{"getchar", "f()",     "int",  false, false},
+		{"halt",    "f()",     "void", false, false},
+		{"len",     "f(str)",  "int",  false, false},
+}};
+
+/**
+ * Gets the fixed symbol id of a universe name, which is its index in `universal_records`
+ * @param name the universe name
+ * @return the symbol id of the name
+ */
+constexpr SymbolId universe_id(std::string_view name) {
+	for (SymbolId i = 0; i < universal_records.size(); i++)
+		if (universal_records[i].name == name)
+			return i;
+	throw "not a universe name";
+}
@@ -0,0 +1,106 @@
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../../src/token.h"
+
+/**
+ * Microbenchmark for keyword recognition on identifier-heavy input
+ * Compares `keyword` with the lookup the lexer did before it, which copied each lexeme into a string and looked it
+ * up twice in a global map
+ * Built with -DGOLF_BENCH=ON, run as `golf_bench_keywords [lexemes]`
+ */
+
+namespace {
+
+// The keyword table as it was, built at startup
+std::map<std::string, TokenType> Keywords = {
+        {"break", Break},
+        {"else", Else},
+        {"for", For},
+        {"func", Func},
+        {"if", If},
+        {"return", Return},
+        {"var", Var},
+};
+
+/**
+ * Recognizes a keyword the way the lexer used to
+ * @param source the input
+ * @param start where the lexeme starts
+ * @param length the length of the lexeme
+ * @return the keyword token type, or Identifier if the lexeme is not a keyword
+ */
+TokenType map_keyword(std::string_view source, std::size_t start, std::size_t length) {
+    auto lexeme = std::string(source.substr(start, length));
+    if (Keywords.count(lexeme))
+        return Keywords[lexeme];
+    return Identifier;
+}
+
+/**
+ * Makes identifier-heavy input, mostly user identifiers of typical lengths and some keywords and predeclared names
+ * @param count the number of lexemes
+ * @param lexemes the start and length of each lexeme in the input
+ * @return the input, lexemes separated by spaces
+ */
+std::string make_input(std::size_t count, std::vector<std::pair<std::size_t, std::size_t>> &lexemes) {
+    const std::vector<std::string> words = {
+            "i", "n", "x", "count", "total", "index", "result", "buffer", "position", "remaining",
+            "fun", "iffy", "variable", "breaks", "returned", "elsewhere", "format", "printi", "prints", "getchar",
+            "if", "for", "var", "else", "func", "break", "return", "true", "false", "int",
+    };
+    std::mt19937 random(411);
+    std::uniform_int_distribution<std::size_t> pick(0, words.size() - 1);
+    std::string input;
+    for (std::size_t i = 0; i < count; i++) {
+        auto &word = words[pick(random)];
+        lexemes.emplace_back(input.size(), word.size());
+        input += word;
+        input += ' ';
+    }
+    return input;
+}
+
+/**
+ * Times a recognizer over every lexeme, keeping the best of several runs
+ * @param name what is printed for the recognizer
+ * @param lexemes the start and length of each lexeme in the input
+ * @param recognize the recognizer
+ */
+template<typename Recognize>
+void measure(const char *name, const std::vector<std::pair<std::size_t, std::size_t>> &lexemes, Recognize recognize) {
+    double best = 0;
+    std::size_t keywords = 0;
+    for (int run = 0; run < 5; run++) {
+        keywords = 0;
+        auto begin = std::chrono::steady_clock::now();
+        for (auto [start, length]: lexemes)
+            keywords += recognize(start, length) != Identifier;
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - begin;
+        auto per_lexeme = elapsed.count() / static_cast<double>(lexemes.size());
+        if (run == 0 || per_lexeme < best)
+            best = per_lexeme;
+    }
+    std::cout << name << ": " << best << " ns per lexeme, " << keywords << " keywords" << std::endl;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    std::size_t count = argc > 1 ? std::stoul(argv[1]) : 10000000;
+    std::vector<std::pair<std::size_t, std::size_t>> lexemes;
+    auto input = make_input(count, lexemes);
+    std::string_view source = input;
+
+    measure("map", lexemes, [&](std::size_t start, std::size_t length) {
+        return map_keyword(source, start, length);
+    });
+    measure("keyword", lexemes, [&](std::size_t start, std::size_t length) {
+        return keyword(source.substr(start, length));
+    });
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,65 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../../src/arena.h"
+#include "../../src/file_input.h"
+#include "../../src/interner.h"
+#include "../../src/lexer.h"
+
+/**
+ * Benchmark for parallel lexing, from one thread up to one per core
+ * Each thread count lexes the whole file with `match_tokens_parallel`, after the serial `match_tokens` as the
+ * baseline, keeping the best of several runs
+ * Built with -DGOLF_BENCH=ON, run as `golf_bench_lexer file [threads]` on a large GoLF file
+ */
+
+namespace {
+
+/**
+ * Times one way of lexing the input, keeping the best of several runs
+ * @param input the input, already read
+ * @param lex lexes the input with a fresh lexer, returning the tokens
+ * @param tokens set to the number of tokens
+ * @return the best time, in milliseconds
+ */
+template<typename Lex>
+double measure(Input &input, Lex lex, std::size_t &tokens) {
+    double best = 0;
+    for (int run = 0; run < 3; run++) {
+        Arena arena;
+        Interner symbols(arena);
+        Lexer lexer(&input, symbols);
+        auto begin = std::chrono::steady_clock::now();
+        tokens = lex(lexer).size();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+        if (run == 0 || elapsed.count() < best)
+            best = elapsed.count();
+    }
+    return best;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " file [threads]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    int most = argc > 2 ? std::stoi(argv[2]) : static_cast<int>(std::thread::hardware_concurrency());
+    FileInput input(argv[1]);
+    input.read();
+
+    std::size_t expected = 0, tokens = 0;
+    auto serial = measure(input, [](Lexer &lexer) { return lexer.match_tokens(false); }, expected);
+    std::cout << "serial: " << serial << " ms, " << expected << " tokens" << std::endl;
+    for (int threads = 1; threads <= std::max(most, 1); threads++) {
+        auto parallel = measure(input, [&](Lexer &lexer) { return lexer.match_tokens_parallel(threads); }, tokens);
+        std::cout << threads << " threads: " << parallel << " ms, " << serial / parallel << "x";
+        if (tokens != expected)
+            std::cout << ", " << tokens << " tokens";
+        std::cout << std::endl;
+    }
+    return EXIT_SUCCESS;
+}